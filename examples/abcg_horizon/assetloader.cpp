@@ -0,0 +1,96 @@
+#include "assetloader.hpp"
+
+#include <exception>
+
+#include "abcg.hpp"
+
+AssetLoader::~AssetLoader() { shutdown(); }
+
+void AssetLoader::load(Task work, Task upload)
+{
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  const std::scoped_lock lock{m_mutex};
+  m_jobs.emplace_back(std::move(work), std::move(upload));
+#else
+  {
+    const std::scoped_lock lock{m_mutex};
+    ++m_runningJobs;
+  }
+  m_workers.emplace_back(
+      [this, work = std::move(work), upload = std::move(upload)]
+      {
+        Task task{upload};
+        try
+        {
+          work();
+        }
+        catch (...)
+        {
+          task = [error = std::current_exception()]
+          { std::rethrow_exception(error); };
+        }
+
+        const std::scoped_lock lock{m_mutex};
+        m_tasks.push_back(std::move(task));
+        --m_runningJobs;
+      });
+#endif
+}
+
+void AssetLoader::enqueue(Task task)
+{
+  const std::scoped_lock lock{m_mutex};
+  m_tasks.push_back(std::move(task));
+}
+
+void AssetLoader::drain(double budget)
+{
+  abcg::ElapsedTimer timer;
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  // GL tasks queued before the job go first
+  if (m_tasks.empty() && !m_jobs.empty())
+  {
+    auto [work, upload]{std::move(m_jobs.front())};
+    m_jobs.pop_front();
+    work();
+    m_tasks.push_back(std::move(upload));
+  }
+#endif
+
+  do
+  {
+    Task task;
+    {
+      const std::scoped_lock lock{m_mutex};
+      if (m_tasks.empty())
+        return;
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  } while (timer.elapsed() < budget);
+}
+
+bool AssetLoader::isLoading() const
+{
+  const std::scoped_lock lock{m_mutex};
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  if (!m_jobs.empty())
+    return true;
+#endif
+  return m_runningJobs > 0 || !m_tasks.empty();
+}
+
+void AssetLoader::shutdown()
+{
+  for (auto &worker : m_workers)
+    worker.join();
+  m_workers.clear();
+
+  const std::scoped_lock lock{m_mutex};
+  m_tasks.clear();
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  m_jobs.clear();
+#endif
+}
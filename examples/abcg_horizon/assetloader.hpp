@@ -0,0 +1,58 @@
+#ifndef ASSETLOADER_HPP_
+#define ASSETLOADER_HPP_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Runs the CPU side of asset loading (file IO, parsing, mesh processing,
+// image decoding) on worker threads and hands the GL side back to the thread
+// that owns the context, which runs it a few milliseconds per frame.
+//
+// GL tasks run in the order they were queued, and a job's upload is queued
+// only once its work is done, so uploads always follow the GL tasks queued
+// before the job was started.
+class AssetLoader
+{
+public:
+  using Task = std::function<void()>;
+
+  AssetLoader() = default;
+  AssetLoader(const AssetLoader &) = delete;
+  AssetLoader &operator=(const AssetLoader &) = delete;
+  ~AssetLoader();
+
+  // Runs work on a worker thread, then queues upload for the GL thread. An
+  // exception thrown by work is rethrown from drain().
+  void load(Task work, Task upload);
+
+  // Queues a task for the GL thread
+  void enqueue(Task task);
+
+  // Runs queued GL tasks until budget seconds have passed. At least one task
+  // runs per call, so a single large upload can exceed the budget.
+  void drain(double budget);
+
+  // Whether any job or GL task is still pending
+  [[nodiscard]] bool isLoading() const;
+
+  // Waits for the workers; queued GL tasks are dropped
+  void shutdown();
+
+private:
+  mutable std::mutex m_mutex;
+  std::deque<Task> m_tasks;
+  std::size_t m_runningJobs{};
+  std::vector<std::thread> m_workers;
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  // Without threads the work runs on the GL thread, one job per drain()
+  std::deque<std::pair<Task, Task>> m_jobs;
+#endif
+};
+
+#endif
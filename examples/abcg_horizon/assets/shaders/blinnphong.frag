@@ -3,13 +3,25 @@
 in vec3 fragN;
 in vec3 fragL;
 in vec3 fragV;
-
-// Light properties
-uniform vec4 Ia, Id, Is;
-
-// Material properties
-uniform vec4 Ka, Kd, Ks;
-uniform float shininess;
+flat in vec4 fragPartColor;
+
+// Camera and light, written once per frame
+layout(std140) uniform FrameUniforms {
+  mat4 viewMatrix;
+  mat4 projMatrix;
+  mat4 viewProjMatrix;
+  vec4 lightDirViewSpace;
+  vec4 Ia, Id, Is;
+};
+
+// Transform and material of the current draw
+layout(std140) uniform DrawUniforms {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+  vec4 Ka, Kd, Ks;
+  float shininess;
+  bool partColored;
+};
 
 out vec4 outColor;
 
@@ -29,9 +41,9 @@ vec4 BlinnPhong(vec3 N, vec3 L, vec3 V) {
     specular = pow(angle, shininess);
   }
 
-  vec4 diffuseColor = Kd * Id * lambertian;
-  vec4 specularColor = Ks * Is * specular;
-  vec4 ambientColor = Ka * Ia;
+  vec4 diffuseColor = Kd * fragPartColor * Id * lambertian;
+  vec4 specularColor = Ks * fragPartColor * Is * specular;
+  vec4 ambientColor = Ka * fragPartColor * Ia;
 
   return ambientColor + diffuseColor + specularColor;
 }
@@ -0,0 +1,4 @@
+#version 410
+
+// Depth only; color writes are masked during the prepass
+void main() {}
@@ -0,0 +1,34 @@
+#version 410
+
+layout(location = 0) in vec3 inPosition;
+
+// Camera and light, written once per frame
+layout(std140) uniform FrameUniforms {
+  mat4 viewMatrix;
+  mat4 projMatrix;
+  mat4 viewProjMatrix;
+  vec4 lightDirViewSpace;
+  vec4 Ia, Id, Is;
+};
+
+// Transform and material of the current draw
+layout(std140) uniform DrawUniforms {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+  vec4 Ka, Kd, Ks;
+  float shininess;
+  bool partColored;
+};
+
+// Decoding of packed vertices (identity for float vertices)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// Same depth as the shading pass, which tests against it with GL_EQUAL
+invariant gl_Position;
+
+void main() {
+  vec3 position = inPosition * positionScale + positionOffset;
+  vec4 worldPosition = modelMatrix * vec4(position, 1.0);
+  gl_Position = viewProjMatrix * worldPosition;
+}
@@ -2,26 +2,64 @@
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
+layout(location = 4) in float inPart;
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
-uniform mat3 normalMatrix;
+// Camera and light, written once per frame
+layout(std140) uniform FrameUniforms {
+  mat4 viewMatrix;
+  mat4 projMatrix;
+  mat4 viewProjMatrix;
+  vec4 lightDirViewSpace;
+  vec4 Ia, Id, Is;
+};
 
-uniform vec4 lightDirWorldSpace;
+// Transform and material of the current draw
+layout(std140) uniform DrawUniforms {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+  vec4 Ka, Kd, Ks;
+  float shininess;
+  bool partColored;
+};
+
+// Decoding of packed vertices (identity for float vertices)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+uniform bool octNormals;
+
+// Colors of the parts of a mesh, picked by the part of the vertex
+layout(std140) uniform PartColors {
+  vec4 partColors[64];
+};
 
 out vec3 fragV;
 out vec3 fragL;
 out vec3 fragN;
+flat out vec4 fragPartColor;
+
+// Matches the depth prepass exactly, for its GL_EQUAL depth test
+invariant gl_Position;
+
+vec3 decodeOctahedral(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
 
 void main() {
-  vec3 P = (viewMatrix * modelMatrix * vec4(inPosition, 1.0)).xyz;
-  vec3 N = normalMatrix * inNormal;
-  vec3 L = -(viewMatrix * lightDirWorldSpace).xyz;
+  vec3 position = inPosition * positionScale + positionOffset;
+  vec3 normal = octNormals ? decodeOctahedral(inNormal.xy) : inNormal;
+
+  vec4 worldPosition = modelMatrix * vec4(position, 1.0);
+  vec3 P = (viewMatrix * worldPosition).xyz;
+  vec3 N = mat3(normalMatrix) * normal;
+  vec3 L = -lightDirViewSpace.xyz;
 
   fragL = L;
   fragV = -P;
   fragN = N;
+  fragPartColor = partColored ? partColors[int(inPart)] : vec4(1.0);
 
-  gl_Position = projMatrix * vec4(P, 1.0);
+  gl_Position = viewProjMatrix * worldPosition;
 }
@@ -3,28 +3,38 @@
 in vec3 fragN;
 in vec3 fragL;
 in vec3 fragV;
+#if defined(DIFFUSE_MAP)
 in vec2 fragTexCoord;
-in vec3 fragPObj;
-in vec3 fragNObj;
-
-// Light properties
-uniform vec4 Ia, Id, Is;
-
-// Material properties
-uniform vec4 Ka, Kd, Ks;
-uniform float shininess;
-
+#endif
+flat in vec4 fragPartColor;
+
+// Camera and light, written once per frame
+layout(std140) uniform FrameUniforms {
+  mat4 viewMatrix;
+  mat4 projMatrix;
+  mat4 viewProjMatrix;
+  vec4 lightDirViewSpace;
+  vec4 Ia, Id, Is;
+};
+
+// Transform and material of the current draw
+layout(std140) uniform DrawUniforms {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+  vec4 Ka, Kd, Ks;
+  float shininess;
+  bool partColored;
+};
+
+#if defined(DIFFUSE_MAP)
 // Diffuse texture sampler
 uniform sampler2D diffuseTex;
-
-// Mapping mode
-// 0: triplanar; 1: cylindrical; 2: spherical; 3: from mesh
-uniform int mappingMode;
+#endif
 
 out vec4 outColor;
 
 // Blinn-Phong reflection model
-vec4 BlinnPhong(vec3 N, vec3 L, vec3 V, vec2 texCoord) {
+vec4 BlinnPhong(vec3 N, vec3 L, vec3 V) {
   N = normalize(N);
   L = normalize(L);
 
@@ -40,85 +50,24 @@ vec4 BlinnPhong(vec3 N, vec3 L, vec3 V, vec2 texCoord) {
     specular = pow(angle, shininess);
   }
 
-  vec4 map_Kd = texture(diffuseTex, texCoord);
+#if defined(DIFFUSE_MAP)
+  vec4 map_Kd = texture(diffuseTex, fragTexCoord);
+#else
+  vec4 map_Kd = vec4(1.0);
+#endif
   vec4 map_Ka = map_Kd;
 
-  vec4 diffuseColor = map_Kd * Kd * Id * lambertian;
-  vec4 specularColor = Ks * Is * specular;
-  vec4 ambientColor = map_Ka * Ka * Ia;
+  vec4 diffuseColor = map_Kd * Kd * fragPartColor * Id * lambertian;
+  vec4 specularColor = Ks * fragPartColor * Is * specular;
+  vec4 ambientColor = map_Ka * Ka * fragPartColor * Ia;
 
   return ambientColor + diffuseColor + specularColor;
 }
 
-// Planar mapping
-vec2 PlanarMappingX(vec3 P) { return vec2(1.0 - P.z, P.y); }
-vec2 PlanarMappingY(vec3 P) { return vec2(P.x, 1.0 - P.z); }
-vec2 PlanarMappingZ(vec3 P) { return P.xy; }
-
-#define PI 3.14159265358979323846
-
-// Cylindrical mapping
-vec2 CylindricalMapping(vec3 P) {
-  float longitude = atan(P.x, P.z);
-  float height = P.y;
-
-  float u = longitude / (2.0 * PI) + 0.5;  // From [-pi, pi] to [0, 1]
-  float v = height - 0.5;                  // Base at y = -0.5
-
-  return vec2(u, v);
-}
-
-// Spherical mapping
-vec2 SphericalMapping(vec3 P) {
-  float longitude = atan(P.x, P.z);
-  float latitude = asin(P.y / length(P));
-
-  float u = longitude / (2.0 * PI) + 0.5;  // From [-pi, pi] to [0, 1]
-  float v = latitude / PI + 0.5;           // From [-pi/2, pi/2] to [0, 1]
-
-  return vec2(u, v);
-}
-
 void main() {
-  vec4 color;
-
-  if (mappingMode == 0) {
-    // Triplanar mapping
-
-    // Sample with x planar mapping
-    vec2 texCoord1 = PlanarMappingX(fragPObj);
-    vec4 color1 = BlinnPhong(fragN, fragL, fragV, texCoord1);
+  vec4 color = BlinnPhong(fragN, fragL, fragV);
 
-    // Sample with y planar mapping
-    vec2 texCoord2 = PlanarMappingY(fragPObj);
-    vec4 color2 = BlinnPhong(fragN, fragL, fragV, texCoord2);
-
-    // Sample with z planar mapping
-    vec2 texCoord3 = PlanarMappingZ(fragPObj);
-    vec4 color3 = BlinnPhong(fragN, fragL, fragV, texCoord3);
-
-    // Compute average based on normal
-    vec3 weight = abs(normalize(fragNObj));
-    color = color1 * weight.x + color2 * weight.y + color3 * weight.z;
-  } else {
-    vec2 texCoord;
-    if (mappingMode == 1) {
-      // Cylindrical mapping
-      texCoord = CylindricalMapping(fragPObj);
-    } else if (mappingMode == 2) {
-      // Spherical mapping
-      texCoord = SphericalMapping(fragPObj);
-    } else if (mappingMode == 3) {
-      // From mesh
-      texCoord = fragTexCoord;
-    }
-    color = BlinnPhong(fragN, fragL, fragV, texCoord);
-  }
-
-  if (gl_FrontFacing) {
-    outColor = color;
-  } else {
-    float i = (color.r + color.g + color.b) / 3.0;
-    outColor = vec4(i, 0, 0, 1.0);
-  }
+  // Back faces in red intensity, chosen without branching
+  float i = (color.r + color.g + color.b) / 3.0;
+  outColor = mix(vec4(i, 0, 0, 1.0), color, float(gl_FrontFacing));
 }
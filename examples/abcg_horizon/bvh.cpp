@@ -0,0 +1,214 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <utility>
+
+namespace
+{
+using Planes = std::array<glm::vec4, 6>;
+
+// Planes of the view volume with normals pointing inward (Gribb/Hartmann)
+Planes frustumPlanes(const glm::mat4 &clipMatrix)
+{
+  const auto row{[&](int index)
+                 {
+                   return glm::vec4{clipMatrix[0][index], clipMatrix[1][index],
+                                    clipMatrix[2][index],
+                                    clipMatrix[3][index]};
+                 }};
+  return {row(3) + row(0), row(3) - row(0), row(3) + row(1),
+          row(3) - row(1), row(3) + row(2), row(3) - row(2)};
+}
+
+enum class Overlap
+{
+  Outside,
+  Partial,
+  Inside
+};
+
+Overlap classify(const Planes &planes, const Bounds &bounds)
+{
+  auto overlap{Overlap::Inside};
+  for (const auto &plane : planes)
+  {
+    const glm::vec3 normal{plane};
+
+    // Corners farthest along and against the normal
+    glm::vec3 positive{bounds.min};
+    glm::vec3 negative{bounds.max};
+    for (const auto axis : {0, 1, 2})
+    {
+      if (normal[axis] >= 0.0f)
+        std::swap(positive[axis], negative[axis]);
+    }
+    if (glm::dot(normal, positive) + plane.w < 0.0f)
+      return Overlap::Outside;
+    if (glm::dot(normal, negative) + plane.w < 0.0f)
+      overlap = Overlap::Partial;
+  }
+  return overlap;
+}
+
+void splitTriangles(const std::vector<glm::vec3> &centroids,
+                    std::vector<std::uint32_t>::iterator first,
+                    std::vector<std::uint32_t>::iterator last,
+                    std::size_t maxTriangles,
+                    std::vector<std::size_t> &chunkSizes)
+{
+  const auto count{static_cast<std::size_t>(last - first)};
+  if (count <= maxTriangles)
+  {
+    chunkSizes.push_back(count);
+    return;
+  }
+
+  Bounds bounds;
+  for (auto it{first}; it != last; ++it)
+    bounds.grow(centroids[*it]);
+  const auto extent{bounds.max - bounds.min};
+  const int axis{extent.x >= extent.y && extent.x >= extent.z ? 0
+                 : extent.y >= extent.z                      ? 1
+                                                             : 2};
+
+  const auto middle{first + static_cast<std::ptrdiff_t>(count / 2)};
+  std::nth_element(first, middle, last,
+                   [&](std::uint32_t a, std::uint32_t b)
+                   { return centroids[a][axis] < centroids[b][axis]; });
+  splitTriangles(centroids, first, middle, maxTriangles, chunkSizes);
+  splitTriangles(centroids, middle, last, maxTriangles, chunkSizes);
+}
+} // namespace
+
+std::vector<IndexRange> chunkTriangles(const std::vector<glm::vec3> &positions,
+                                       std::vector<GLuint> &indices,
+                                       std::size_t maxTriangles)
+{
+  const auto triangleCount{indices.size() / 3};
+  std::vector<glm::vec3> centroids(triangleCount);
+  for (std::size_t triangle{}; triangle < triangleCount; ++triangle)
+  {
+    centroids[triangle] = (positions[indices[3 * triangle + 0]] +
+                           positions[indices[3 * triangle + 1]] +
+                           positions[indices[3 * triangle + 2]]) /
+                          3.0f;
+  }
+
+  std::vector<std::uint32_t> order(triangleCount);
+  std::iota(order.begin(), order.end(), 0u);
+  std::vector<std::size_t> chunkSizes;
+  splitTriangles(centroids, order.begin(), order.end(),
+                 std::max<std::size_t>(maxTriangles, 1), chunkSizes);
+
+  std::vector<GLuint> reordered;
+  reordered.reserve(indices.size());
+  for (const auto triangle : order)
+  {
+    reordered.insert(reordered.end(),
+                     indices.begin() + static_cast<std::ptrdiff_t>(3 * triangle),
+                     indices.begin() +
+                         static_cast<std::ptrdiff_t>(3 * triangle + 3));
+  }
+  indices = std::move(reordered);
+
+  std::vector<IndexRange> ranges;
+  std::size_t first{};
+  for (const auto size : chunkSizes)
+  {
+    ranges.push_back({first, 3 * size});
+    first += 3 * size;
+  }
+  return ranges;
+}
+
+std::vector<Bounds> rangeBounds(const std::vector<glm::vec3> &positions,
+                                const std::vector<GLuint> &indices,
+                                const std::vector<IndexRange> &ranges)
+{
+  std::vector<Bounds> bounds(ranges.size());
+  for (std::size_t range{}; range < ranges.size(); ++range)
+  {
+    const auto &[first, count]{ranges[range]};
+    for (auto index{first}; index < first + count; ++index)
+      bounds[range].grow(positions[indices[index]]);
+  }
+  return bounds;
+}
+
+void Bvh::build(std::vector<Bounds> leaves)
+{
+  m_leaves = std::move(leaves);
+  m_nodes.clear();
+  if (!m_leaves.empty())
+    buildNode(0, static_cast<std::uint32_t>(m_leaves.size()));
+}
+
+std::uint32_t Bvh::buildNode(std::uint32_t firstLeaf, std::uint32_t leafCount)
+{
+  const auto index{static_cast<std::uint32_t>(m_nodes.size())};
+  m_nodes.push_back({{}, firstLeaf, leafCount, 0});
+
+  Bounds bounds;
+  if (leafCount == 1)
+  {
+    bounds = m_leaves[firstLeaf];
+  }
+  else
+  {
+    const auto half{leafCount / 2};
+    buildNode(firstLeaf, half);
+    const auto second{buildNode(firstLeaf + half, leafCount - half)};
+    bounds = m_nodes[index + 1].bounds;
+    bounds.grow(m_nodes[second].bounds);
+    m_nodes[index].secondChild = second;
+  }
+  m_nodes[index].bounds = bounds;
+  return index;
+}
+
+void Bvh::cull(const glm::mat4 &clipMatrix,
+               std::vector<std::size_t> &visible) const
+{
+  cull(clipMatrix, visible, {});
+}
+
+void Bvh::cull(const glm::mat4 &clipMatrix, std::vector<std::size_t> &visible,
+               const std::function<bool(std::size_t)> &isCandidate) const
+{
+  visible.clear();
+  if (m_nodes.empty())
+    return;
+
+  const auto planes{frustumPlanes(clipMatrix)};
+  std::array<std::uint32_t, 64> stack{};
+  std::size_t stackSize{};
+  stack[stackSize++] = 0;
+  while (stackSize > 0)
+  {
+    const auto &node{m_nodes[stack[--stackSize]]};
+    if (node.leafCount == 1 && isCandidate && !isCandidate(node.firstLeaf))
+      continue;
+
+    const auto overlap{classify(planes, node.bounds)};
+    if (overlap == Overlap::Outside)
+      continue;
+
+    if (overlap == Overlap::Inside || node.leafCount == 1)
+    {
+      for (auto leaf{node.firstLeaf}; leaf < node.firstLeaf + node.leafCount;
+           ++leaf)
+      {
+        if (!isCandidate || isCandidate(leaf))
+          visible.push_back(leaf);
+      }
+      continue;
+    }
+
+    // First child on top, to keep the leaves in order
+    const auto index{static_cast<std::uint32_t>(&node - m_nodes.data())};
+    stack[stackSize++] = node.secondChild;
+    stack[stackSize++] = index + 1;
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef BVH_HPP_
+#define BVH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "abcg.hpp"
+#include "vertexcache.hpp"
+
+// Axis-aligned bounding box; empty until grown
+struct Bounds
+{
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+  void grow(const glm::vec3 &point)
+  {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+  void grow(const Bounds &other)
+  {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+};
+
+// Reorders the triangles of indices into spatially compact chunks of at most
+// maxTriangles triangles, by splitting at the median along the longest axis
+// until the pieces are small enough. Returns the range of each chunk; nearby
+// chunks come out next to each other.
+[[nodiscard]] std::vector<IndexRange>
+chunkTriangles(const std::vector<glm::vec3> &positions,
+               std::vector<GLuint> &indices, std::size_t maxTriangles);
+
+// Bounds of the vertices referenced by each range
+[[nodiscard]] std::vector<Bounds>
+rangeBounds(const std::vector<glm::vec3> &positions,
+            const std::vector<GLuint> &indices,
+            const std::vector<IndexRange> &ranges);
+
+// Bounding volume hierarchy over boxes given in a spatially coherent order,
+// like the chunks of chunkTriangles. Every node covers a contiguous run of
+// leaves, split in half at each level.
+class Bvh
+{
+public:
+  void build(std::vector<Bounds> leaves);
+
+  // Replaces visible with the leaves whose boxes are at least partly inside
+  // the view volume of clipMatrix (projection * view * model), in order.
+  // Subtrees fully inside or outside are not descended into.
+  void cull(const glm::mat4 &clipMatrix,
+            std::vector<std::size_t> &visible) const;
+  // Same, skipping leaves for which isCandidate(leaf) is false before
+  // testing them
+  void cull(const glm::mat4 &clipMatrix, std::vector<std::size_t> &visible,
+            const std::function<bool(std::size_t)> &isCandidate) const;
+
+  [[nodiscard]] std::size_t leafCount() const { return m_leaves.size(); }
+  [[nodiscard]] const Bounds &leaf(std::size_t index) const
+  {
+    return m_leaves.at(index);
+  }
+
+private:
+  struct Node
+  {
+    Bounds bounds;
+    std::uint32_t firstLeaf{};
+    std::uint32_t leafCount{};
+    std::uint32_t secondChild{}; // The first child follows its parent
+  };
+
+  std::vector<Node> m_nodes;
+  std::vector<Bounds> m_leaves;
+
+  std::uint32_t buildNode(std::uint32_t firstLeaf, std::uint32_t leafCount);
+};
+
+#endif
@@ -0,0 +1,461 @@
+#include "collision.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <limits>
+#include <random>
+
+namespace
+{
+// Closest point of triangle abc to p (Ericson, Real-Time Collision Detection)
+glm::vec3 closestOnTriangle(const glm::vec3 &p, const glm::vec3 &a,
+                            const glm::vec3 &b, const glm::vec3 &c)
+{
+  const auto ab{b - a};
+  const auto ac{c - a};
+  const auto ap{p - a};
+  const auto d1{glm::dot(ab, ap)};
+  const auto d2{glm::dot(ac, ap)};
+  if (d1 <= 0.0f && d2 <= 0.0f)
+    return a;
+
+  const auto bp{p - b};
+  const auto d3{glm::dot(ab, bp)};
+  const auto d4{glm::dot(ac, bp)};
+  if (d3 >= 0.0f && d4 <= d3)
+    return b;
+
+  const auto vc{d1 * d4 - d3 * d2};
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    return a + ab * (d1 / (d1 - d3));
+
+  const auto cp{p - c};
+  const auto d5{glm::dot(ab, cp)};
+  const auto d6{glm::dot(ac, cp)};
+  if (d6 >= 0.0f && d5 <= d6)
+    return c;
+
+  const auto vb{d5 * d2 - d1 * d6};
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    return a + ac * (d2 / (d2 - d6));
+
+  const auto va{d3 * d6 - d5 * d4};
+  if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+  const auto denominator{1.0f / (va + vb + vc)};
+  return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Distance along the ray to triangle abc, from either side (Möller-Trumbore)
+std::optional<float> intersectTriangle(const glm::vec3 &origin,
+                                       const glm::vec3 &direction,
+                                       const glm::vec3 &a, const glm::vec3 &b,
+                                       const glm::vec3 &c)
+{
+  const auto ab{b - a};
+  const auto ac{c - a};
+  const auto p{glm::cross(direction, ac)};
+  const auto determinant{glm::dot(ab, p)};
+  if (std::abs(determinant) < 1e-12f)
+    return std::nullopt;
+
+  const auto inverse{1.0f / determinant};
+  const auto ao{origin - a};
+  const auto u{glm::dot(ao, p) * inverse};
+  if (u < 0.0f || u > 1.0f)
+    return std::nullopt;
+
+  const auto q{glm::cross(ao, ab)};
+  const auto v{glm::dot(direction, q) * inverse};
+  if (v < 0.0f || u + v > 1.0f)
+    return std::nullopt;
+
+  const auto t{glm::dot(ac, q) * inverse};
+  if (t < 0.0f)
+    return std::nullopt;
+  return t;
+}
+
+bool overlaps(const Bounds &first, const Bounds &second)
+{
+  return glm::all(glm::lessThanEqual(first.min, second.max)) &&
+         glm::all(glm::lessThanEqual(second.min, first.max));
+}
+} // namespace
+
+void CollisionMesh::build(const std::vector<glm::vec3> &positions,
+                          const std::vector<GLuint> &indices,
+                          const glm::mat4 &modelMatrix, float cellSize)
+{
+  m_triangles.clear();
+  m_triangles.reserve(indices.size() / 3);
+  m_bounds = {};
+  for (std::size_t index{}; index + 2 < indices.size(); index += 3)
+  {
+    const auto transform{[&](std::size_t corner)
+                         {
+                           return glm::vec3{
+                               modelMatrix *
+                               glm::vec4{positions.at(indices[corner]), 1.0f}};
+                         }};
+    const Triangle triangle{transform(index), transform(index + 1),
+                            transform(index + 2)};
+    m_bounds.grow(triangle.a);
+    m_bounds.grow(triangle.b);
+    m_bounds.grow(triangle.c);
+    m_triangles.push_back(triangle);
+  }
+
+  m_cellStart.clear();
+  m_cellTriangles.clear();
+  m_visited.assign(m_triangles.size(), 0);
+  m_stamp = 0;
+  if (m_triangles.empty())
+    return;
+
+  // Grow the cells until the grid fits in maxCells
+  const auto extent{glm::max(m_bounds.max - m_bounds.min, glm::vec3{1e-4f})};
+  m_cellSize = std::max(cellSize, 1e-4f);
+  while (true)
+  {
+    m_cells = glm::max(glm::ivec3{glm::ceil(extent / m_cellSize)},
+                       glm::ivec3{1});
+    if (static_cast<std::size_t>(m_cells.x) * m_cells.y * m_cells.z <=
+        maxCells)
+      break;
+    m_cellSize *= 1.5f;
+  }
+
+  // Count, then fill, the triangles overlapping each cell by bounding box
+  const auto cellRange{[&](const Triangle &triangle)
+                       {
+                         Bounds bounds;
+                         bounds.grow(triangle.a);
+                         bounds.grow(triangle.b);
+                         bounds.grow(triangle.c);
+                         return std::pair{cellOf(bounds.min),
+                                          cellOf(bounds.max)};
+                       }};
+  const auto forEachCell{[&](const Triangle &triangle, auto visit)
+                         {
+                           const auto [low, high]{cellRange(triangle)};
+                           for (auto z{low.z}; z <= high.z; ++z)
+                             for (auto y{low.y}; y <= high.y; ++y)
+                               for (auto x{low.x}; x <= high.x; ++x)
+                                 visit(cellIndex({x, y, z}));
+                         }};
+
+  m_cellStart.assign(static_cast<std::size_t>(m_cells.x) * m_cells.y *
+                             m_cells.z +
+                         1,
+                     0);
+  for (const auto &triangle : m_triangles)
+    forEachCell(triangle, [&](std::size_t cell) { ++m_cellStart[cell + 1]; });
+  for (std::size_t cell{1}; cell < m_cellStart.size(); ++cell)
+    m_cellStart[cell] += m_cellStart[cell - 1];
+
+  m_cellTriangles.resize(m_cellStart.back());
+  auto next{m_cellStart};
+  for (std::size_t triangle{}; triangle < m_triangles.size(); ++triangle)
+  {
+    forEachCell(m_triangles[triangle],
+                [&](std::size_t cell)
+                {
+                  m_cellTriangles[next[cell]++] =
+                      static_cast<std::uint32_t>(triangle);
+                });
+  }
+}
+
+glm::ivec3 CollisionMesh::cellOf(const glm::vec3 &point) const
+{
+  const glm::ivec3 cell{glm::floor((point - m_bounds.min) / m_cellSize)};
+  return glm::clamp(cell, glm::ivec3{0}, m_cells - 1);
+}
+
+std::size_t CollisionMesh::cellIndex(const glm::ivec3 &cell) const
+{
+  return (static_cast<std::size_t>(cell.z) * m_cells.y + cell.y) * m_cells.x +
+         cell.x;
+}
+
+std::uint32_t CollisionMesh::nextStamp() const
+{
+  if (++m_stamp == 0)
+  {
+    std::fill(m_visited.begin(), m_visited.end(), 0);
+    m_stamp = 1;
+  }
+  return m_stamp;
+}
+
+template <typename F>
+void CollisionMesh::forEachTriangle(const Bounds &bounds, F visit) const
+{
+  if (m_triangles.empty() || !overlaps(bounds, m_bounds))
+    return;
+
+  const auto stamp{nextStamp()};
+  const auto low{cellOf(bounds.min)};
+  const auto high{cellOf(bounds.max)};
+  for (auto z{low.z}; z <= high.z; ++z)
+  {
+    for (auto y{low.y}; y <= high.y; ++y)
+    {
+      for (auto x{low.x}; x <= high.x; ++x)
+      {
+        const auto cell{cellIndex({x, y, z})};
+        for (auto entry{m_cellStart[cell]}; entry < m_cellStart[cell + 1];
+             ++entry)
+        {
+          const auto triangle{m_cellTriangles[entry]};
+          if (m_visited[triangle] == stamp)
+            continue;
+          m_visited[triangle] = stamp;
+          visit(triangle);
+        }
+      }
+    }
+  }
+}
+
+std::optional<RayHit> CollisionMesh::raycast(const glm::vec3 &origin,
+                                             const glm::vec3 &direction,
+                                             float maxDistance) const
+{
+  if (m_triangles.empty())
+    return std::nullopt;
+
+  // Clip the ray to the grid (slab test)
+  const auto inverse{1.0f / direction};
+  auto enter{0.0f};
+  auto exit{maxDistance};
+  for (const auto axis : {0, 1, 2})
+  {
+    if (direction[axis] == 0.0f)
+    {
+      if (origin[axis] < m_bounds.min[axis] ||
+          origin[axis] > m_bounds.max[axis])
+        return std::nullopt;
+      continue;
+    }
+    const auto t0{(m_bounds.min[axis] - origin[axis]) * inverse[axis]};
+    const auto t1{(m_bounds.max[axis] - origin[axis]) * inverse[axis]};
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+  }
+  if (enter > exit)
+    return std::nullopt;
+
+  // Walk the cells along the ray (Amanatides-Woo), stopping at the first cell
+  // that ends beyond the nearest hit found so far
+  auto cell{cellOf(origin + direction * enter)};
+  glm::ivec3 step{};
+  glm::vec3 tMax{};
+  glm::vec3 tDelta{};
+  for (const auto axis : {0, 1, 2})
+  {
+    if (direction[axis] > 0.0f)
+    {
+      step[axis] = 1;
+      tMax[axis] = (m_bounds.min[axis] +
+                    static_cast<float>(cell[axis] + 1) * m_cellSize -
+                    origin[axis]) *
+                   inverse[axis];
+      tDelta[axis] = m_cellSize * inverse[axis];
+    }
+    else if (direction[axis] < 0.0f)
+    {
+      step[axis] = -1;
+      tMax[axis] =
+          (m_bounds.min[axis] + static_cast<float>(cell[axis]) * m_cellSize -
+           origin[axis]) *
+          inverse[axis];
+      tDelta[axis] = -m_cellSize * inverse[axis];
+    }
+    else
+    {
+      tMax[axis] = std::numeric_limits<float>::infinity();
+      tDelta[axis] = std::numeric_limits<float>::infinity();
+    }
+  }
+
+  std::optional<RayHit> hit;
+  const auto stamp{nextStamp()};
+  while (true)
+  {
+    const auto index{cellIndex(cell)};
+    for (auto entry{m_cellStart[index]}; entry < m_cellStart[index + 1];
+         ++entry)
+    {
+      const auto triangle{m_cellTriangles[entry]};
+      if (m_visited[triangle] == stamp)
+        continue;
+      m_visited[triangle] = stamp;
+
+      const auto &[a, b, c]{m_triangles[triangle]};
+      const auto distance{intersectTriangle(origin, direction, a, b, c)};
+      if (!distance || *distance > maxDistance ||
+          (hit && *distance >= hit->distance))
+        continue;
+
+      auto normal{glm::normalize(glm::cross(b - a, c - a))};
+      if (glm::dot(normal, direction) > 0.0f)
+        normal = -normal;
+      hit = RayHit{*distance, origin + direction * *distance, normal,
+                   triangle};
+    }
+
+    const auto axis{tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2)
+                                    : (tMax.y < tMax.z ? 1 : 2)};
+    const auto cellExit{tMax[axis]};
+    if ((hit && hit->distance <= cellExit) || cellExit > exit)
+      break;
+
+    cell[axis] += step[axis];
+    if (cell[axis] < 0 || cell[axis] >= m_cells[axis])
+      break;
+    tMax[axis] += tDelta[axis];
+  }
+  return hit;
+}
+
+std::optional<SurfacePoint>
+CollisionMesh::closestPoint(const glm::vec3 &point, float maxDistance) const
+{
+  // Search boxes of growing size, so nearby surfaces stay cheap to find
+  std::optional<SurfacePoint> closest;
+  auto radius{std::min(m_cellSize, maxDistance)};
+  while (true)
+  {
+    Bounds bounds{point - radius, point + radius};
+    forEachTriangle(bounds,
+                    [&](std::uint32_t triangle)
+                    {
+                      const auto &[a, b, c]{m_triangles[triangle]};
+                      const auto candidate{closestOnTriangle(point, a, b, c)};
+                      const auto distance{glm::distance(point, candidate)};
+                      if (distance <= maxDistance &&
+                          (!closest || distance < closest->distance))
+                        closest = SurfacePoint{candidate, distance, triangle};
+                    });
+
+    // Anything closer lies inside the box already searched
+    if ((closest && closest->distance <= radius) || radius >= maxDistance)
+      return closest;
+    radius = std::min(radius * 2.0f, maxDistance);
+  }
+}
+
+void CollisionMesh::overlapSphere(const glm::vec3 &center, float radius,
+                                  std::vector<Contact> &contacts) const
+{
+  contacts.clear();
+  const Bounds bounds{center - radius, center + radius};
+  forEachTriangle(bounds,
+                  [&](std::uint32_t triangle)
+                  {
+                    const auto &[a, b, c]{m_triangles[triangle]};
+                    const auto point{closestOnTriangle(center, a, b, c)};
+                    const auto offset{center - point};
+                    const auto distance{glm::length(offset)};
+                    if (distance >= radius)
+                      return;
+
+                    // Centre on the surface: push out along the face normal
+                    auto normal{distance > 1e-6f
+                                    ? offset / distance
+                                    : glm::normalize(
+                                          glm::cross(b - a, c - a))};
+                    contacts.push_back(
+                        {point, normal, radius - distance, triangle});
+                  });
+}
+
+void benchmarkCollision(const std::vector<glm::vec3> &positions,
+                        const std::vector<GLuint> &indices,
+                        const glm::mat4 &modelMatrix, float cellSize)
+{
+  Bounds original;
+  for (const auto &position : positions)
+    original.grow(glm::vec3{modelMatrix * glm::vec4{position, 1.0f}});
+  const auto extent{original.max - original.min};
+
+  for (const int side : {1, 2, 4})
+  {
+    // side x side copies of the mesh side by side on the ground plane
+    std::vector<glm::vec3> tiledPositions;
+    std::vector<GLuint> tiledIndices;
+    for (int tile{}; tile < side * side; ++tile)
+    {
+      const glm::vec3 offset{static_cast<float>(tile % side) * extent.x, 0.0f,
+                             static_cast<float>(tile / side) * extent.z};
+      const auto base{static_cast<GLuint>(tiledPositions.size())};
+      for (const auto &position : positions)
+        tiledPositions.push_back(
+            glm::vec3{modelMatrix * glm::vec4{position, 1.0f}} + offset);
+      for (const auto index : indices)
+        tiledIndices.push_back(base + index);
+    }
+
+    const auto start{std::chrono::steady_clock::now()};
+    CollisionMesh mesh;
+    mesh.build(tiledPositions, tiledIndices, glm::mat4{1.0f}, cellSize);
+    const auto built{std::chrono::steady_clock::now()};
+
+    // Kart-sized queries at random places over the whole area
+    std::mt19937 random{1234u};
+    std::uniform_real_distribution<float> x{
+        original.min.x, original.min.x + static_cast<float>(side) * extent.x};
+    std::uniform_real_distribution<float> y{original.min.y, original.max.y};
+    std::uniform_real_distribution<float> z{
+        original.min.z, original.min.z + static_cast<float>(side) * extent.z};
+    std::uniform_real_distribution<float> angle{0.0f, glm::two_pi<float>()};
+
+    constexpr int queries{20000};
+    std::size_t found{};
+    std::vector<Contact> contacts;
+    const auto time{[&](auto query)
+                    {
+                      const auto begin{std::chrono::steady_clock::now()};
+                      for (int i{}; i < queries; ++i)
+                        query();
+                      const std::chrono::duration<double, std::micro> elapsed{
+                          std::chrono::steady_clock::now() - begin};
+                      return elapsed.count() / queries;
+                    }};
+    const auto sphereTime{time(
+        [&]
+        {
+          mesh.overlapSphere({x(random), y(random), z(random)}, 0.4f,
+                             contacts);
+          found += contacts.size();
+        })};
+    const auto rayTime{time(
+        [&]
+        {
+          const auto a{angle(random)};
+          found += mesh.raycast({x(random), y(random), z(random)},
+                                {std::sin(a), 0.0f, std::cos(a)}, 10.0f)
+                       .has_value();
+        })};
+    const auto closestTime{time(
+        [&]
+        {
+          found += mesh.closestPoint({x(random), y(random), z(random)}, 2.0f)
+                       .has_value();
+        })};
+
+    const std::chrono::duration<double, std::milli> buildTime{built - start};
+    fmt::print("collision: {} triangles, {} cells, built in {:.2f} ms; "
+               "sphere {:.3f} us, ray {:.3f} us, closest {:.3f} us per query "
+               "({} hits)\n",
+               mesh.triangleCount(), mesh.cellCount(), buildTime.count(),
+               sphereTime, rayTime, closestTime, found);
+  }
+}
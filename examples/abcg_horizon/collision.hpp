@@ -0,0 +1,113 @@
+#ifndef COLLISION_HPP_
+#define COLLISION_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "abcg.hpp"
+#include "bvh.hpp"
+
+struct RayHit
+{
+  float distance{};
+  glm::vec3 point{};
+  glm::vec3 normal{}; // Of the triangle, facing the ray
+  std::size_t triangle{};
+};
+
+struct SurfacePoint
+{
+  glm::vec3 point{};
+  float distance{};
+  std::size_t triangle{};
+};
+
+// Sphere touching a triangle: moving the sphere by normal * depth separates
+// them
+struct Contact
+{
+  glm::vec3 point{};
+  glm::vec3 normal{};
+  float depth{};
+  std::size_t triangle{};
+};
+
+// Static triangles in world space binned into a uniform grid, for collision
+// and picking queries that only look at the cells they pass through.
+// Queries reuse scratch memory and must not run concurrently.
+class CollisionMesh
+{
+public:
+  struct Triangle
+  {
+    glm::vec3 a{}, b{}, c{};
+  };
+
+  // Transforms the triangles by modelMatrix. Cells are cellSize wide, made
+  // larger if the grid would have more than maxCells of them.
+  void build(const std::vector<glm::vec3> &positions,
+             const std::vector<GLuint> &indices, const glm::mat4 &modelMatrix,
+             float cellSize);
+
+  // Nearest hit along direction (normalized) within maxDistance
+  [[nodiscard]] std::optional<RayHit> raycast(const glm::vec3 &origin,
+                                              const glm::vec3 &direction,
+                                              float maxDistance) const;
+
+  // Nearest surface point within maxDistance
+  [[nodiscard]] std::optional<SurfacePoint>
+  closestPoint(const glm::vec3 &point, float maxDistance) const;
+
+  // Replaces contacts with the triangles a sphere overlaps
+  void overlapSphere(const glm::vec3 &center, float radius,
+                     std::vector<Contact> &contacts) const;
+
+  [[nodiscard]] std::size_t triangleCount() const
+  {
+    return m_triangles.size();
+  }
+  [[nodiscard]] std::size_t cellCount() const
+  {
+    return m_cellStart.empty() ? 0 : m_cellStart.size() - 1;
+  }
+
+  // Triangles keep the order of the indices given to build
+  [[nodiscard]] const Triangle &triangle(std::size_t index) const
+  {
+    return m_triangles.at(index);
+  }
+  [[nodiscard]] const Bounds &bounds() const { return m_bounds; }
+
+private:
+  static constexpr std::size_t maxCells{1u << 20};
+
+  std::vector<Triangle> m_triangles;
+  Bounds m_bounds;
+  float m_cellSize{1.0f};
+  glm::ivec3 m_cells{};
+
+  // Triangles of cell i are m_cellTriangles[m_cellStart[i]..m_cellStart[i+1])
+  std::vector<std::uint32_t> m_cellStart;
+  std::vector<std::uint32_t> m_cellTriangles;
+
+  // Query stamp per triangle, so triangles in several cells are tested once
+  mutable std::vector<std::uint32_t> m_visited;
+  mutable std::uint32_t m_stamp{};
+
+  [[nodiscard]] glm::ivec3 cellOf(const glm::vec3 &point) const;
+  [[nodiscard]] std::size_t cellIndex(const glm::ivec3 &cell) const;
+  [[nodiscard]] std::uint32_t nextStamp() const;
+
+  // Calls visit(triangle) once per triangle in the cells overlapping bounds
+  template <typename F> void forEachTriangle(const Bounds &bounds, F visit) const;
+};
+
+// Times queries on grids of 1, 4 and 16 tiled copies of a mesh and
+// prints the cost per query, to check that it stays flat as the mesh grows
+void benchmarkCollision(const std::vector<glm::vec3> &positions,
+                        const std::vector<GLuint> &indices,
+                        const glm::mat4 &modelMatrix, float cellSize);
+
+#endif
@@ -0,0 +1,132 @@
+#include "glstate.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace
+{
+struct State
+{
+  std::optional<GLuint> program;
+  std::optional<GLuint> vertexArray;
+  std::optional<GLuint> activeUnit;
+  // Texture by unit and target
+  std::vector<std::pair<std::pair<GLuint, GLenum>, GLuint>> textures;
+  std::vector<std::pair<GLuint, GLuint>> samplers;
+  std::vector<std::pair<GLenum, bool>> capabilities;
+  std::optional<GLenum> frontFace;
+  std::optional<std::pair<GLenum, GLenum>> blendFunc;
+  glstate::Stats stats;
+};
+
+State &state()
+{
+  static State state;
+  return state;
+}
+
+// Records value and returns whether it differs from the known one
+template <typename T> bool change(std::optional<T> &current, const T &value)
+{
+  auto &stats{state().stats};
+  if (current == value)
+  {
+    ++stats.skipped;
+    return false;
+  }
+  current = value;
+  ++stats.issued;
+  return true;
+}
+
+template <typename K, typename V>
+bool change(std::vector<std::pair<K, V>> &current, const K &key,
+            const V &value)
+{
+  const auto it{std::find_if(current.begin(), current.end(),
+                             [&](const auto &entry)
+                             { return entry.first == key; })};
+  std::optional<V> known;
+  if (it != current.end())
+    known = it->second;
+  if (!change(known, value))
+    return false;
+
+  if (it != current.end())
+    it->second = value;
+  else
+    current.emplace_back(key, value);
+  return true;
+}
+
+void activeTexture(GLuint unit)
+{
+  auto &current{state().activeUnit};
+  if (current == unit)
+    return;
+  current = unit;
+  abcg::glActiveTexture(GL_TEXTURE0 + unit);
+}
+} // namespace
+
+namespace glstate
+{
+void invalidate()
+{
+  const auto stats{state().stats};
+  state() = State{};
+  state().stats = stats;
+}
+
+void useProgram(GLuint program)
+{
+  if (change(state().program, program))
+    abcg::glUseProgram(program);
+}
+
+void bindVertexArray(GLuint vertexArray)
+{
+  if (change(state().vertexArray, vertexArray))
+    abcg::glBindVertexArray(vertexArray);
+}
+
+void bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+  if (!change(state().textures, std::pair{unit, target}, texture))
+    return;
+  activeTexture(unit);
+  abcg::glBindTexture(target, texture);
+}
+
+void bindSampler(GLuint unit, GLuint sampler)
+{
+  if (change(state().samplers, unit, sampler))
+    abcg::glBindSampler(unit, sampler);
+}
+
+void setEnabled(GLenum capability, bool enabled)
+{
+  if (!change(state().capabilities, capability, enabled))
+    return;
+  if (enabled)
+    abcg::glEnable(capability);
+  else
+    abcg::glDisable(capability);
+}
+
+void frontFace(GLenum mode)
+{
+  if (change(state().frontFace, mode))
+    abcg::glFrontFace(mode);
+}
+
+void blendFunc(GLenum source, GLenum destination)
+{
+  if (change(state().blendFunc, std::pair{source, destination}))
+    abcg::glBlendFunc(source, destination);
+}
+
+const Stats &stats() { return state().stats; }
+} // namespace glstate
@@ -0,0 +1,40 @@
+#ifndef GLSTATE_HPP_
+#define GLSTATE_HPP_
+
+#include <cstddef>
+
+#include "abcg.hpp"
+
+// Last values set through these functions, so that setting the same program,
+// vertex array, texture, sampler, capability or blend function again costs
+// no GL call. Must be used from the GL thread only.
+//
+// State changed by direct GL calls is not seen. ImGui restores everything it
+// changes, but code that binds textures or vertex arrays on its own (uploads
+// and VAO setup) must leave them unbound, or be followed by invalidate().
+namespace glstate
+{
+struct Stats
+{
+  std::size_t issued{};
+  std::size_t skipped{};
+};
+
+// Forgets every value, so the next call of each kind reaches GL
+void invalidate();
+
+void useProgram(GLuint program);
+void bindVertexArray(GLuint vertexArray);
+void bindTexture(GLuint unit, GLenum target, GLuint texture);
+void bindSampler(GLuint unit, GLuint sampler);
+void setEnabled(GLenum capability, bool enabled);
+void frontFace(GLenum mode);
+void blendFunc(GLenum source, GLenum destination);
+
+inline void enable(GLenum capability) { setEnabled(capability, true); }
+inline void disable(GLenum capability) { setEnabled(capability, false); }
+
+[[nodiscard]] const Stats &stats();
+} // namespace glstate
+
+#endif
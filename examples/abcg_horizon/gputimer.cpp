@@ -0,0 +1,59 @@
+#include "gputimer.hpp"
+
+void GpuTimer::initializeGL()
+{
+#if !defined(__EMSCRIPTEN__)
+  abcg::glGenQueries(static_cast<GLsizei>(m_queries.size()), m_queries.data());
+#endif
+  m_frame = 0;
+  m_milliseconds = 0.0;
+}
+
+void GpuTimer::terminateGL()
+{
+#if !defined(__EMSCRIPTEN__)
+  abcg::glDeleteQueries(static_cast<GLsizei>(m_queries.size()),
+                        m_queries.data());
+#endif
+  m_queries = {};
+}
+
+bool GpuTimer::isSupported() const
+{
+#if !defined(__EMSCRIPTEN__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void GpuTimer::begin()
+{
+#if !defined(__EMSCRIPTEN__)
+  // Collect the query issued last frame, if the GPU is done with it
+  const auto previous{m_queries.at((m_frame + 1) % m_queries.size())};
+  if (m_frame > 0)
+  {
+    GLint available{};
+    abcg::glGetQueryObjectiv(previous, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available != 0)
+    {
+      GLuint64 nanoseconds{};
+      abcg::glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &nanoseconds);
+      const auto sample{static_cast<double>(nanoseconds) / 1.0e6};
+      m_milliseconds = m_frame == 1 ? sample
+                                    : 0.9 * m_milliseconds + 0.1 * sample;
+    }
+  }
+
+  abcg::glBeginQuery(GL_TIME_ELAPSED, m_queries.at(m_frame % m_queries.size()));
+#endif
+}
+
+void GpuTimer::end()
+{
+#if !defined(__EMSCRIPTEN__)
+  abcg::glEndQuery(GL_TIME_ELAPSED);
+  ++m_frame;
+#endif
+}
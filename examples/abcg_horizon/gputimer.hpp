@@ -0,0 +1,30 @@
+#ifndef GPUTIMER_HPP_
+#define GPUTIMER_HPP_
+
+#include <array>
+
+#include "abcg.hpp"
+
+// GPU time of a span of commands, averaged over recent frames. Results are
+// read a frame late so the CPU never waits for them. Timer queries are not
+// in WebGL 2, where the time stays at zero.
+class GpuTimer
+{
+public:
+  void initializeGL();
+  void terminateGL();
+
+  void begin();
+  void end();
+
+  // Smoothed time between begin and end, in milliseconds
+  [[nodiscard]] double milliseconds() const { return m_milliseconds; }
+  [[nodiscard]] bool isSupported() const;
+
+private:
+  std::array<GLuint, 2> m_queries{};
+  std::size_t m_frame{};
+  double m_milliseconds{};
+};
+
+#endif
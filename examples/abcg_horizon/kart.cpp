@@ -2,6 +2,8 @@
 #include <glm/gtx/fast_trigonometry.hpp>
 #include <glm/gtx/hash.hpp>
 
+#include <cmath>
+
 void Kart::moveKart(float speed, float side)
 {
     if (speed > 0)
@@ -20,10 +22,50 @@ void Kart::moveKart(float speed, float side)
         }
         m_position += glm::vec3(speed * glm::sin(glm::radians(m_angle)), 0.0f, speed * glm::cos(glm::radians(m_angle)));
     }
+}
+
+void Kart::resolveCollisions(const CollisionMesh &mesh)
+{
+    // One wall per pass, deepest first; the passes settle corners, where
+    // leaving one wall moves the kart into another
+    for (int pass{}; pass < 4; ++pass)
+    {
+        const glm::vec3 center{m_position + glm::vec3{0.0f, radius, 0.0f}};
+        mesh.overlapSphere(center, radius, m_contacts);
 
+        glm::vec3 push{0.0f};
+        for (const auto &contact : m_contacts)
+        {
+            // Floors and ramps hold the kart up; only walls push it sideways
+            const glm::vec3 normal{contact.normal.x, 0.0f, contact.normal.z};
+            if (std::abs(contact.normal.y) >= 0.7f || contact.depth <= glm::length(push))
+                continue;
+            push = glm::normalize(normal) * contact.depth;
+        }
+        if (glm::length(push) < 1e-5f)
+            break;
+        m_position += push;
+    }
+}
+
+void Kart::storePreviousState()
+{
+    m_previousPosition = m_position;
+    m_previousAngle = m_angle;
+}
+
+void Kart::interpolate(float alpha)
+{
+    m_renderPosition = glm::mix(m_previousPosition, m_position, alpha);
+    m_renderAngle = glm::mix(m_previousAngle, m_angle, alpha);
+    updateModelMatrix();
+}
+
+void Kart::updateModelMatrix()
+{
     glm::mat4 model{1.0f};
-    model = glm::translate(model, m_position);
-    model = glm::rotate(model, glm::radians(m_angle), glm::vec3(0, 1, 0));
+    model = glm::translate(model, m_renderPosition);
+    model = glm::rotate(model, glm::radians(m_renderAngle), glm::vec3(0, 1, 0));
     model = glm::scale(model, glm::vec3(0.2f));
     m_modelMatrix = model;
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
+#include <vector>
+
+#include "collision.hpp"
 
 class OpenGLWindow;
 
@@ -22,7 +25,26 @@ private:
   bool m_dacc{false};
   glm::vec3 m_position{0.0f, 0.0f, -20.0f};
 
+  // State at the start of the last simulation step, and the blend of both
+  // states that is drawn
+  glm::vec3 m_previousPosition{m_position};
+  float m_previousAngle{m_angle};
+  glm::vec3 m_renderPosition{m_position};
+  float m_renderAngle{m_angle};
+
+  // Body of the kart for collisions, in world units
+  static constexpr float radius{0.4f};
+  std::vector<Contact> m_contacts;
+
   void moveKart(float speed, float side);
+  // Slides the kart out of the walls it overlaps
+  void resolveCollisions(const CollisionMesh &mesh);
+  // Call before each simulation step
+  void storePreviousState();
+  // Places the drawn kart alpha of the way from the previous state to the
+  // current one
+  void interpolate(float alpha);
+  void updateModelMatrix();
 };
 
 #endif
\ No newline at end of file
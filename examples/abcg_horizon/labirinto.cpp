@@ -1,128 +1,88 @@
 #include "labirinto.hpp"
 
 #include <fmt/core.h>
-#include <tiny_obj_loader.h>
 
 #include <cppitertools/itertools.hpp>
 #include <filesystem>
-#include <glm/gtx/hash.hpp>
-#include <unordered_map>
 #include <glm/gtc/matrix_inverse.hpp>
+#include <unordered_map>
 
-// Explicit specialization of std::hash for Vertex
-namespace std
+#include "bvh.hpp"
+#include "glstate.hpp"
+#include "meshcache.hpp"
+#include "meshkernels.hpp"
+#include "objparser.hpp"
+#include "samplers.hpp"
+#include "texturedata.hpp"
+#include "vertexcache.hpp"
+#include "vertexwelder.hpp"
+
+void Labirinto::bakeVisibility(const CollisionMesh &mesh)
 {
-  template <>
-  struct hash<Vertex>
-  {
-    size_t operator()(Vertex const &vertex) const noexcept
-    {
-      const std::size_t h1{std::hash<glm::vec3>()(vertex.position)};
-      const std::size_t h2{std::hash<glm::vec3>()(vertex.normal)};
-      const std::size_t h3{std::hash<glm::vec2>()(vertex.texCoord)};
-      return h1 ^ h2 ^ h3;
-    }
-  };
-} // namespace std
+  abcg::ElapsedTimer timer;
+  m_pvs.bake(mesh, m_ranges, visibilityCellSize, visibilityEyeMin,
+             visibilityEyeMax);
+  fmt::print("Visibility of {} chunks from {} cells baked in {:.2f} ms\n",
+             m_ranges.size(), m_pvs.cellCount(), timer.elapsed() * 1000.0);
+}
 
-void Labirinto::computeNormals()
+void Labirinto::bakePlanarTexCoords()
 {
-  // Clear previous vertex normals
-  for (auto &vertex : m_vertices)
+  // Planar mapping along the dominant axis of each face, which for walls
+  // facing a single axis matches a triplanar mapping. Vertices shared by
+  // faces facing different axes are split.
+  std::vector<Vertex> vertices;
+  vertices.reserve(m_vertices.size());
+  std::unordered_map<std::uint64_t, GLuint> splits;
+  splits.reserve(m_vertices.size());
+
+  for (std::size_t triangle{}; triangle + 2 < m_indices.size(); triangle += 3)
   {
-    vertex.normal = glm::zero<glm::vec3>();
+    const auto &a{m_vertices[m_indices[triangle + 0]].position};
+    const auto &b{m_vertices[m_indices[triangle + 1]].position};
+    const auto &c{m_vertices[m_indices[triangle + 2]].position};
+    const auto normal{glm::abs(glm::cross(b - a, c - a))};
+    const int axis{normal.x >= normal.y && normal.x >= normal.z ? 0
+                   : normal.y >= normal.z                      ? 1
+                                                               : 2};
+
+    for (const auto corner : {0, 1, 2})
+    {
+      auto &index{m_indices[triangle + corner]};
+      const auto key{std::uint64_t{index} * 3 + static_cast<std::uint64_t>(axis)};
+      const auto [split, isNew]{
+          splits.try_emplace(key, static_cast<GLuint>(vertices.size()))};
+      if (isNew)
+      {
+        auto vertex{m_vertices[index]};
+        const auto &P{vertex.position};
+        vertex.texCoord = axis == 0   ? glm::vec2{1.0f - P.z, P.y}
+                          : axis == 1 ? glm::vec2{P.x, 1.0f - P.z}
+                                      : glm::vec2{P.x, P.y};
+        vertices.push_back(vertex);
+      }
+      index = split->second;
+    }
   }
 
-  // Compute face normals
-  for (const auto offset : iter::range<int>(0, m_indices.size(), 3))
-  {
-    // Get face vertices
-    Vertex &a{m_vertices.at(m_indices.at(offset + 0))};
-    Vertex &b{m_vertices.at(m_indices.at(offset + 1))};
-    Vertex &c{m_vertices.at(m_indices.at(offset + 2))};
-
-    // Compute normal
-    const auto edge1{b.position - a.position};
-    const auto edge2{c.position - b.position};
-    glm::vec3 normal{glm::cross(edge1, edge2)};
-
-    // Accumulate on vertices
-    a.normal += normal;
-    b.normal += normal;
-    c.normal += normal;
-  }
+  m_vertices = std::move(vertices);
+  m_hasTexCoords = true;
+}
 
-  // Normalize
-  for (auto &vertex : m_vertices)
-  {
-    vertex.normal = glm::normalize(vertex.normal);
-  }
+void Labirinto::computeBounds()
+{
+  ::computeBounds(m_vertices, m_boundsMin, m_boundsMax);
+}
 
+void Labirinto::computeNormals()
+{
+  ::computeNormals(m_vertices, m_indices);
   m_hasNormals = true;
 }
 
 void Labirinto::computeTangents()
 {
-  // Reserve space for bitangents
-  std::vector<glm::vec3> bitangents(m_vertices.size(), glm::vec3(0));
-
-  // Compute face tangents and bitangents
-  for (const auto offset : iter::range<int>(0, m_indices.size(), 3))
-  {
-    // Get face indices
-    const auto i1{m_indices.at(offset + 0)};
-    const auto i2{m_indices.at(offset + 1)};
-    const auto i3{m_indices.at(offset + 2)};
-
-    // Get face vertices
-    Vertex &v1{m_vertices.at(i1)};
-    Vertex &v2{m_vertices.at(i2)};
-    Vertex &v3{m_vertices.at(i3)};
-
-    const auto e1{v2.position - v1.position};
-    const auto e2{v3.position - v1.position};
-    const auto delta1{v2.texCoord - v1.texCoord};
-    const auto delta2{v3.texCoord - v1.texCoord};
-
-    glm::mat2 M;
-    M[0][0] = delta2.t;
-    M[0][1] = -delta1.t;
-    M[1][0] = -delta2.s;
-    M[1][1] = delta1.s;
-    M *= (1.0f / (delta1.s * delta2.t - delta2.s * delta1.t));
-
-    const auto tangent{glm::vec4(M[0][0] * e1.x + M[0][1] * e2.x,
-                                 M[0][0] * e1.y + M[0][1] * e2.y,
-                                 M[0][0] * e1.z + M[0][1] * e2.z, 0.0f)};
-
-    const auto bitangent{glm::vec3(M[1][0] * e1.x + M[1][1] * e2.x,
-                                   M[1][0] * e1.y + M[1][1] * e2.y,
-                                   M[1][0] * e1.z + M[1][1] * e2.z)};
-
-    // Accumulate on vertices
-    v1.tangent += tangent;
-    v2.tangent += tangent;
-    v3.tangent += tangent;
-
-    bitangents.at(i1) += bitangent;
-    bitangents.at(i2) += bitangent;
-    bitangents.at(i3) += bitangent;
-  }
-
-  for (auto &&[i, vertex] : iter::enumerate(m_vertices))
-  {
-    const auto &n{vertex.normal};
-    const auto &t{glm::vec3(vertex.tangent)};
-
-    // Orthogonalize t with respect to n
-    const auto tangent{t - n * glm::dot(n, t)};
-    vertex.tangent = glm::vec4(glm::normalize(tangent), 0);
-
-    // Compute handedness of re-orthogonalized basis
-    const auto b{glm::cross(n, t)};
-    const auto handedness{glm::dot(b, bitangents.at(i))};
-    vertex.tangent.w = (handedness < 0.0f) ? -1.0f : 1.0f;
-  }
+  ::computeTangents(m_vertices, m_indices);
 }
 
 void Labirinto::createBuffers()
@@ -134,16 +94,17 @@ void Labirinto::createBuffers()
   // VBO
   abcg::glGenBuffers(1, &m_VBO);
   abcg::glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-  abcg::glBufferData(GL_ARRAY_BUFFER, sizeof(m_vertices[0]) * m_vertices.size(),
-                     m_vertices.data(), GL_STATIC_DRAW);
+  abcg::glBufferData(GL_ARRAY_BUFFER, m_vertexData.size(), m_vertexData.data(),
+                     GL_STATIC_DRAW);
   abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  m_vertexData = {};
 
   // EBO
+  const auto &indexData{m_indexLayout.data()};
   abcg::glGenBuffers(1, &m_EBO);
   abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-  abcg::glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     sizeof(m_indices[0]) * m_indices.size(), m_indices.data(),
-                     GL_STATIC_DRAW);
+  abcg::glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(),
+                     indexData.data(), GL_STATIC_DRAW);
   abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
@@ -164,7 +125,7 @@ void Labirinto::loadDiffuseTexture(std::string_view path)
     return;
 
   abcg::glDeleteTextures(1, &m_diffuseTexture);
-  m_diffuseTexture = abcg::opengl::loadTexture(path);
+  m_diffuseTexture = createTexture(decodeTexture(path));
 }
 
 void Labirinto::loadNormalTexture(std::string_view path)
@@ -173,37 +134,110 @@ void Labirinto::loadNormalTexture(std::string_view path)
     return;
 
   abcg::glDeleteTextures(1, &m_normalTexture);
-  m_normalTexture = abcg::opengl::loadTexture(path);
+  m_normalTexture = createTexture(decodeTexture(path));
 }
 
-void Labirinto::loadObj(std::string_view path, bool standardize)
+void Labirinto::readDiffuseTexture(std::string_view path)
 {
-  const auto basePath{std::filesystem::path{path}.parent_path().string() + "/"};
+  if (!std::filesystem::exists(path))
+    return;
 
-  tinyobj::ObjReaderConfig readerConfig;
-  readerConfig.mtl_search_path = basePath; // Path to material files
+  m_pendingDiffuseTexture = decodeTexture(path);
+}
+
+void Labirinto::readNormalTexture(std::string_view path)
+{
+  if (!std::filesystem::exists(path))
+    return;
 
-  tinyobj::ObjReader reader;
+  m_pendingNormalTexture = decodeTexture(path);
+}
+
+void Labirinto::loadObj(std::string_view path, bool standardize,
+                        bool packVertices)
+{
+  readObj(path, standardize, packVertices);
+  uploadGL();
+}
 
-  if (!reader.ParseFromFile(path.data(), readerConfig))
+void Labirinto::loadFromCache(const MeshCache &cache,
+                              const std::string &basePath)
+{
+  cache.copyTo(m_vertices, m_indices);
+
+  const auto &info{cache.info()};
+  m_hasNormals = info.hasNormals;
+  m_hasTexCoords = info.hasTexCoords;
+  m_boundsMin = info.boundsMin;
+  m_boundsMax = info.boundsMax;
+  m_Ka = info.Ka;
+  m_Kd = info.Kd;
+  m_Ks = info.Ks;
+  m_shininess = info.shininess;
+
+  m_ranges.clear();
+  GLuint previous{};
+  for (const auto end : info.rangeEnds)
   {
-    if (!reader.Error().empty())
-    {
-      throw abcg::Exception{abcg::Exception::Runtime(
-          fmt::format("Failed to load model {} ({})", path, reader.Error()))};
-    }
-    throw abcg::Exception{
-        abcg::Exception::Runtime(fmt::format("Failed to load model {}", path))};
+    m_ranges.push_back({previous, end - previous});
+    previous = end;
   }
+  if (m_ranges.empty())
+    m_ranges.push_back({0, m_indices.size()});
+
+  if (!info.diffuseTexName.empty())
+    readDiffuseTexture(basePath + info.diffuseTexName);
+
+  if (!info.normalTexName.empty())
+    readNormalTexture(basePath + info.normalTexName);
+}
+
+void Labirinto::prepareBuffers()
+{
+  m_bvh.build(rangeBounds(positions(), m_indices, m_ranges));
 
-  if (!reader.Warning().empty())
+  // Narrow the indices, splitting large meshes into meshlets
+  m_indexLayout.build(m_vertices, m_indices, m_ranges);
+  const auto vertices{m_indexLayout.layoutVertices(m_vertices)};
+
+  if (m_packVertices)
+  {
+    // Planar coordinates span the whole maze, too far for half floats
+    m_vertexData = m_vertexFormat.pack(vertices, m_boundsMin, m_boundsMax,
+                                       m_hasTexCoords, true);
+  }
+  else
+  {
+    m_vertexFormat = VertexFormat{};
+    const auto *bytes{reinterpret_cast<const std::byte *>(vertices.data())};
+    m_vertexData.assign(bytes, bytes + sizeof(vertices[0]) * vertices.size());
+  }
+}
+
+void Labirinto::readObj(std::string_view path, bool standardize,
+                        bool packVertices)
+{
+  abcg::ElapsedTimer timer;
+  m_packVertices = packVertices;
+
+  const auto basePath{std::filesystem::path{path}.parent_path().string() + "/"};
+
+  // Try the binary cache first
+  const MeshCacheKey cacheKey{
+      MeshCache::hashObj(path),
+      standardize ? MeshCacheKey::standardized : 0u, sizeof(Vertex)};
+  const auto cachePath{MeshCache::cachePath(path)};
+  if (MeshCache cache; cache.open(cachePath, cacheKey))
   {
-    fmt::print("Warning: {}\n", reader.Warning());
+    loadFromCache(cache, basePath);
+    prepareBuffers();
+    fmt::print("{}: loaded from cache in {:.2f} ms\n", path,
+               timer.elapsed() * 1000.0);
+    return;
   }
 
-  const auto &attrib{reader.GetAttrib()};
-  const auto &shapes{reader.GetShapes()};
-  const auto &materials{reader.GetMaterials()};
+  const auto obj{parseObj(path)};
+  const auto &materials{obj.materials};
 
   m_vertices.clear();
   m_indices.clear();
@@ -211,65 +245,62 @@ void Labirinto::loadObj(std::string_view path, bool standardize)
   m_hasNormals = false;
   m_hasTexCoords = false;
 
-  // A key:value map with key=Vertex and value=index
-  std::unordered_map<Vertex, GLuint> hash{};
+  // Welds corners that share position, normal and texture coordinates
+  abcg::ElapsedTimer weldTimer;
+  VertexWelder<8> welder{obj.indices.size()};
+  m_indices.reserve(obj.indices.size());
 
-  // Loop over shapes
-  for (const auto &shape : shapes)
+  // Loop over triangle corners
+  for (const auto &index : obj.indices)
   {
-    // Loop over indices
-    for (const auto offset : iter::range(shape.mesh.indices.size()))
+    // Vertex position
+    const int startIndex{3 * index.vertex};
+    const float vx{obj.positions.at(startIndex + 0)};
+    const float vy{obj.positions.at(startIndex + 1)};
+    const float vz{obj.positions.at(startIndex + 2)};
+
+    // Vertex normal
+    float nx{};
+    float ny{};
+    float nz{};
+    if (index.normal >= 0)
     {
-      // Access to vertex
-      const tinyobj::index_t index{shape.mesh.indices.at(offset)};
-
-      // Vertex position
-      const int startIndex{3 * index.vertex_index};
-      const float vx{attrib.vertices.at(startIndex + 0)};
-      const float vy{attrib.vertices.at(startIndex + 1)};
-      const float vz{attrib.vertices.at(startIndex + 2)};
-
-      // Vertex normal
-      float nx{};
-      float ny{};
-      float nz{};
-      if (index.normal_index >= 0)
-      {
-        m_hasNormals = true;
-        const int normalStartIndex{3 * index.normal_index};
-        nx = attrib.normals.at(normalStartIndex + 0);
-        ny = attrib.normals.at(normalStartIndex + 1);
-        nz = attrib.normals.at(normalStartIndex + 2);
-      }
-
-      // Vertex texture coordinates
-      float tu{};
-      float tv{};
-      if (index.texcoord_index >= 0)
-      {
-        m_hasTexCoords = true;
-        const int texCoordsStartIndex{2 * index.texcoord_index};
-        tu = attrib.texcoords.at(texCoordsStartIndex + 0);
-        tv = attrib.texcoords.at(texCoordsStartIndex + 1);
-      }
+      m_hasNormals = true;
+      const int normalStartIndex{3 * index.normal};
+      nx = obj.normals.at(normalStartIndex + 0);
+      ny = obj.normals.at(normalStartIndex + 1);
+      nz = obj.normals.at(normalStartIndex + 2);
+    }
 
-      Vertex vertex{};
-      vertex.position = {vx, vy, vz};
-      vertex.normal = {nx, ny, nz};
-      vertex.texCoord = {tu, tv};
+    // Vertex texture coordinates
+    float tu{};
+    float tv{};
+    if (index.texCoord >= 0)
+    {
+      m_hasTexCoords = true;
+      const int texCoordsStartIndex{2 * index.texCoord};
+      tu = obj.texCoords.at(texCoordsStartIndex + 0);
+      tv = obj.texCoords.at(texCoordsStartIndex + 1);
+    }
 
-      // If hash doesn't contain this vertex
-      if (hash.count(vertex) == 0)
-      {
-        // Add this index (size of m_vertices)
-        hash[vertex] = m_vertices.size();
-        // Add this vertex
-        m_vertices.push_back(vertex);
-      }
+    Vertex vertex{};
+    vertex.position = {vx, vy, vz};
+    vertex.normal = {nx, ny, nz};
+    vertex.texCoord = {tu, tv};
 
-      m_indices.push_back(hash[vertex]);
+    const auto [vertexIndex, isNew]{
+        welder.insert(welder.makeKey({vx, vy, vz, nx, ny, nz, tu, tv}))};
+    if (isNew)
+    {
+      // Add this vertex
+      m_vertices.push_back(vertex);
     }
+
+    m_indices.push_back(vertexIndex);
   }
+  const auto weldTime{weldTimer.elapsed()};
+
+  MeshCacheInfo cacheInfo;
 
   // Use properties of first material, if available
   if (!materials.empty())
@@ -280,17 +311,15 @@ void Labirinto::loadObj(std::string_view path, bool standardize)
     m_Ks = glm::vec4(mat.specular[0], mat.specular[1], mat.specular[2], 1);
     m_shininess = mat.shininess;
 
-    if (!mat.diffuse_texname.empty())
-      loadDiffuseTexture(basePath + mat.diffuse_texname);
+    cacheInfo.diffuseTexName = mat.diffuseTexName;
+    cacheInfo.normalTexName =
+        mat.normalTexName.empty() ? mat.bumpTexName : mat.normalTexName;
 
-    if (!mat.normal_texname.empty())
-    {
-      loadNormalTexture(basePath + mat.normal_texname);
-    }
-    else if (!mat.bump_texname.empty())
-    {
-      loadNormalTexture(basePath + mat.bump_texname);
-    }
+    if (!cacheInfo.diffuseTexName.empty())
+      readDiffuseTexture(basePath + cacheInfo.diffuseTexName);
+
+    if (!cacheInfo.normalTexName.empty())
+      readNormalTexture(basePath + cacheInfo.normalTexName);
   }
   else
   {
@@ -301,6 +330,8 @@ void Labirinto::loadObj(std::string_view path, bool standardize)
     m_shininess = 100.0f;
   }
 
+  // Vertex attribute kernels, timed to compare instruction sets
+  abcg::ElapsedTimer attributeTimer;
   if (standardize)
   {
     this->standardize();
@@ -311,91 +342,97 @@ void Labirinto::loadObj(std::string_view path, bool standardize)
     computeNormals();
   }
 
+  bakePlanarTexCoords();
+
   if (m_hasTexCoords)
   {
     computeTangents();
   }
-
-  createBuffers();
+  const auto attributeTime{attributeTimer.elapsed()};
+
+  // Chunks of nearby triangles, culled as a whole
+  m_ranges = chunkTriangles(positions(), m_indices, maxChunkTriangles);
+  optimizeMesh(path, m_vertices, m_indices, m_ranges);
+
+  computeBounds();
+
+  cacheInfo.hasNormals = m_hasNormals;
+  cacheInfo.hasTexCoords = m_hasTexCoords;
+  cacheInfo.boundsMin = m_boundsMin;
+  cacheInfo.boundsMax = m_boundsMax;
+  cacheInfo.Ka = m_Ka;
+  cacheInfo.Kd = m_Kd;
+  cacheInfo.Ks = m_Ks;
+  cacheInfo.shininess = m_shininess;
+  for (const auto &range : m_ranges)
+    cacheInfo.rangeEnds.push_back(
+        static_cast<GLuint>(range.first + range.count));
+  MeshCache::save(cachePath, cacheKey, m_vertices, m_indices, cacheInfo);
+
+  prepareBuffers();
+  fmt::print("{}: parsed in {:.2f} ms (welding {:.2f} ms, attributes "
+             "{:.2f} ms with {})\n",
+             path, timer.elapsed() * 1000.0, weldTime * 1000.0,
+             attributeTime * 1000.0, meshKernelsName());
 }
 
-void Labirinto::paintGL(GLuint m_program, glm::mat4 &viewMatrix, glm::mat4 &projMatrix, GLfloat &lightDir, GLfloat &Ia, GLfloat &Id, GLfloat &Is)
+void Labirinto::paintGL(Program &program, UniformStream &uniforms,
+                        const glm::mat4 &viewMatrix,
+                        const glm::mat4 &projMatrix)
 {
-  glUseProgram(m_program);
-
-  // Get location of uniform variables (could be precomputed)
-  GLint viewMatrixLoc{glGetUniformLocation(m_program, "viewMatrix")};
-  GLint projMatrixLoc{glGetUniformLocation(m_program, "projMatrix")};
-  GLint modelMatrixLoc{glGetUniformLocation(m_program, "modelMatrix")};
-  GLint normalMatrixLoc{glGetUniformLocation(m_program, "normalMatrix")};
-  GLint lightDirLoc{glGetUniformLocation(m_program, "lightDirWorldSpace")};
-  GLint shininessLoc{glGetUniformLocation(m_program, "shininess")};
-  GLint IaLoc{glGetUniformLocation(m_program, "Ia")};
-  GLint IdLoc{glGetUniformLocation(m_program, "Id")};
-  GLint IsLoc{glGetUniformLocation(m_program, "Is")};
-  GLint KaLoc{glGetUniformLocation(m_program, "Ka")};
-  GLint KdLoc{glGetUniformLocation(m_program, "Kd")};
-  GLint KsLoc{glGetUniformLocation(m_program, "Ks")};
-  GLint diffuseTexLoc{glGetUniformLocation(m_program, "diffuseTex")};
-  GLint mappingModeLoc{glGetUniformLocation(m_program, "mappingMode")};
-
-  glUniform4fv(lightDirLoc, 1, &lightDir);
-  glUniform4fv(IaLoc, 1, &Ia);
-  glUniform4fv(IdLoc, 1, &Id);
-  glUniform4fv(IsLoc, 1, &Is);
-  glUniform1i(diffuseTexLoc, 0);
-
-  glUniformMatrix4fv(viewMatrixLoc, 1, GL_FALSE, &viewMatrix[0][0]);
-  glUniformMatrix4fv(projMatrixLoc, 1, GL_FALSE, &projMatrix[0][0]);
-
-  glm::mat4 wallModel{1.0f};
-  wallModel = glm::scale(wallModel, glm::vec3(0.20f));
-  glUniformMatrix4fv(modelMatrixLoc, 1, GL_FALSE, &wallModel[0][0]);
-
-  auto modelViewMatrix2{glm::mat3(viewMatrix * wallModel)};
-  glm::mat3 normalMatrix2{glm::inverseTranspose(modelViewMatrix2)};
-  glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, &normalMatrix2[0][0]);
-
-  glUniform1f(shininessLoc, m_shininess);
-  glUniform4fv(KaLoc, 1, &m_Ka.x);
-  glUniform4fv(KdLoc, 1, &m_Kd.x);
-  glUniform4fv(KsLoc, 1, &m_Ks.x);
-
-  glUniform1i(mappingModeLoc, 0);
+  program.use();
+  program.set(program.uniform("diffuseTex"), 0);
+  m_vertexFormat.setUniforms(program);
+
+  DrawUniforms draw;
+  draw.modelMatrix = getModelMatrix();
+  draw.normalMatrix = glm::mat4{
+      glm::inverseTranspose(glm::mat3(viewMatrix * draw.modelMatrix))};
+  draw.Ka = m_Ka;
+  draw.Kd = m_Kd;
+  draw.Ks = m_Ks;
+  draw.shininess = m_shininess;
+  uniforms.push(drawUniformsBinding, draw);
+
+  // Chunks hidden from the camera's cell are skipped before the frustum test
+  const glm::vec3 eye{glm::inverse(viewMatrix)[3]};
+  if (const auto *visible{m_pvs.find(eye)})
+  {
+    m_bvh.cull(projMatrix * viewMatrix * draw.modelMatrix, m_drawRanges,
+               [&](std::size_t chunk) { return Pvs::isVisible(visible, chunk); });
+  }
+  else
+  {
+    m_bvh.cull(projMatrix * viewMatrix * draw.modelMatrix, m_drawRanges);
+  }
   render();
 }
 
-void Labirinto::render(int numTriangles) const
+std::vector<glm::vec3> Labirinto::positions() const
 {
-  abcg::glBindVertexArray(m_VAO);
-
-  abcg::glActiveTexture(GL_TEXTURE0);
-  abcg::glBindTexture(GL_TEXTURE_2D, m_diffuseTexture);
-
-  abcg::glActiveTexture(GL_TEXTURE1);
-  abcg::glBindTexture(GL_TEXTURE_2D, m_normalTexture);
-
-  abcg::glActiveTexture(GL_TEXTURE2);
-  abcg::glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeTexture);
-
-  // Set minification and magnification parameters
-  abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  // Set texture wrapping parameters
-  abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  std::vector<glm::vec3> positions;
+  positions.reserve(m_vertices.size());
+  for (const auto &vertex : m_vertices)
+    positions.push_back(vertex.position);
+  return positions;
+}
 
-  const auto numIndices{(numTriangles < 0) ? m_indices.size()
-                                           : numTriangles * 3};
+void Labirinto::render() const
+{
+  glstate::bindVertexArray(m_VAO);
+  glstate::bindTexture(0, GL_TEXTURE_2D, m_diffuseTexture);
+  glstate::bindTexture(1, GL_TEXTURE_2D, m_normalTexture);
+  glstate::bindTexture(2, GL_TEXTURE_CUBE_MAP, m_cubeTexture);
 
-  abcg::glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(numIndices),
-                       GL_UNSIGNED_INT, nullptr);
+  // The floor is seen at grazing angles
+  glstate::bindSampler(0, samplers::get(Sampler::Anisotropic));
+  glstate::bindSampler(1, samplers::get(Sampler::LinearMipRepeat));
+  glstate::bindSampler(2, samplers::get(Sampler::Clamp));
 
-  abcg::glBindVertexArray(0);
+  m_indexLayout.draw(m_drawRanges);
 }
 
-void Labirinto::setupVAO(GLuint program)
+void Labirinto::setupVAO(const Program &program)
 {
   // Release previous VAO
   abcg::glDeleteVertexArrays(1, &m_VAO);
@@ -409,45 +446,50 @@ void Labirinto::setupVAO(GLuint program)
   abcg::glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
 
   // Bind vertex attributes
-  const GLint positionAttribute{
-      abcg::glGetAttribLocation(program, "inPosition")};
-  if (positionAttribute >= 0)
+  if (m_vertexFormat.isPacked())
   {
-    abcg::glEnableVertexAttribArray(positionAttribute);
-    abcg::glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE,
-                                sizeof(Vertex), nullptr);
+    m_vertexFormat.setupAttributes(program);
   }
-
-  const GLint normalAttribute{abcg::glGetAttribLocation(program, "inNormal")};
-  if (normalAttribute >= 0)
+  else
   {
-    abcg::glEnableVertexAttribArray(normalAttribute);
-    GLsizei offset{sizeof(glm::vec3)};
-    abcg::glVertexAttribPointer(normalAttribute, 3, GL_FLOAT, GL_FALSE,
-                                sizeof(Vertex),
-                                reinterpret_cast<void *>(offset));
-  }
+    const GLint positionAttribute{program.attribute("inPosition")};
+    if (positionAttribute >= 0)
+    {
+      abcg::glEnableVertexAttribArray(positionAttribute);
+      abcg::glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE,
+                                  sizeof(Vertex), nullptr);
+    }
 
-  const GLint texCoordAttribute{
-      abcg::glGetAttribLocation(program, "inTexCoord")};
-  if (texCoordAttribute >= 0)
-  {
-    abcg::glEnableVertexAttribArray(texCoordAttribute);
-    GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3)};
-    abcg::glVertexAttribPointer(texCoordAttribute, 2, GL_FLOAT, GL_FALSE,
-                                sizeof(Vertex),
-                                reinterpret_cast<void *>(offset));
-  }
+    const GLint normalAttribute{program.attribute("inNormal")};
+    if (normalAttribute >= 0)
+    {
+      abcg::glEnableVertexAttribArray(normalAttribute);
+      GLsizei offset{sizeof(glm::vec3)};
+      abcg::glVertexAttribPointer(normalAttribute, 3, GL_FLOAT, GL_FALSE,
+                                  sizeof(Vertex),
+                                  reinterpret_cast<void *>(offset));
+    }
 
-  const GLint tangentCoordAttribute{
-      abcg::glGetAttribLocation(program, "inTangent")};
-  if (tangentCoordAttribute >= 0)
-  {
-    abcg::glEnableVertexAttribArray(tangentCoordAttribute);
-    GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec2)};
-    abcg::glVertexAttribPointer(tangentCoordAttribute, 4, GL_FLOAT, GL_FALSE,
-                                sizeof(Vertex),
-                                reinterpret_cast<void *>(offset));
+    const GLint texCoordAttribute{program.attribute("inTexCoord")};
+    if (texCoordAttribute >= 0)
+    {
+      abcg::glEnableVertexAttribArray(texCoordAttribute);
+      GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3)};
+      abcg::glVertexAttribPointer(texCoordAttribute, 2, GL_FLOAT, GL_FALSE,
+                                  sizeof(Vertex),
+                                  reinterpret_cast<void *>(offset));
+    }
+
+    const GLint tangentCoordAttribute{program.attribute("inTangent")};
+    if (tangentCoordAttribute >= 0)
+    {
+      abcg::glEnableVertexAttribArray(tangentCoordAttribute);
+      GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3) +
+                     sizeof(glm::vec2)};
+      abcg::glVertexAttribPointer(tangentCoordAttribute, 4, GL_FLOAT, GL_FALSE,
+                                  sizeof(Vertex),
+                                  reinterpret_cast<void *>(offset));
+    }
   }
 
   // End of binding
@@ -458,27 +500,7 @@ void Labirinto::setupVAO(GLuint program)
 void Labirinto::standardize()
 {
   // Center to origin and normalize largest bound to [-1, 1]
-
-  // Get bounds
-  glm::vec3 max(std::numeric_limits<float>::lowest());
-  glm::vec3 min(std::numeric_limits<float>::max());
-  for (const auto &vertex : m_vertices)
-  {
-    max.x = std::max(max.x, vertex.position.x);
-    max.y = std::max(max.y, vertex.position.y);
-    max.z = std::max(max.z, vertex.position.z);
-    min.x = std::min(min.x, vertex.position.x);
-    min.y = std::min(min.y, vertex.position.y);
-    min.z = std::min(min.z, vertex.position.z);
-  }
-
-  // Center and scale
-  const auto center{(min + max) / 2.0f};
-  const auto scaling{2.0f / glm::length(max - min)};
-  for (auto &vertex : m_vertices)
-  {
-    vertex.position = (vertex.position - center) * scaling;
-  }
+  ::standardize(m_vertices);
 }
 
 void Labirinto::terminateGL()
@@ -489,4 +511,23 @@ void Labirinto::terminateGL()
   abcg::glDeleteBuffers(1, &m_EBO);
   abcg::glDeleteBuffers(1, &m_VBO);
   abcg::glDeleteVertexArrays(1, &m_VAO);
-}
\ No newline at end of file
+}
+
+void Labirinto::uploadGL()
+{
+  if (m_pendingDiffuseTexture)
+  {
+    abcg::glDeleteTextures(1, &m_diffuseTexture);
+    m_diffuseTexture = createTexture(*m_pendingDiffuseTexture);
+    m_pendingDiffuseTexture.reset();
+  }
+
+  if (m_pendingNormalTexture)
+  {
+    abcg::glDeleteTextures(1, &m_normalTexture);
+    m_normalTexture = createTexture(*m_pendingNormalTexture);
+    m_pendingNormalTexture.reset();
+  }
+
+  createBuffers();
+}
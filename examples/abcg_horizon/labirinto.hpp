@@ -1,9 +1,23 @@
 #ifndef MODEL_HPP_
 #define MODEL_HPP_
 
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 
 #include "abcg.hpp"
+#include "bvh.hpp"
+#include "meshlets.hpp"
+#include "pvs.hpp"
+#include "program.hpp"
+#include "shadervariants.hpp"
+#include "texturedata.hpp"
+#include "uniformstream.hpp"
+#include "vertexformat.hpp"
+
+class MeshCache;
 
 struct Vertex
 {
@@ -24,14 +38,39 @@ struct Vertex
 class Labirinto
 {
 public:
+  // Shader variant for this material: textured once it has texture
+  // coordinates and a diffuse texture
+  [[nodiscard]] std::string_view shaderDefines() const
+  {
+    return m_hasTexCoords && m_diffuseTexture != 0 ? shaderdefines::diffuseMap
+                                                   : std::string_view{};
+  }
+
   void loadCubeTexture(const std::string &path);
   void loadDiffuseTexture(std::string_view path);
   void loadNormalTexture(std::string_view path);
-  void loadObj(std::string_view path, bool standardize = true);
-  void render(int numTriangles = -1) const;
-  void setupVAO(GLuint program);
+  void loadObj(std::string_view path, bool standardize = true,
+               bool packVertices = false);
+
+  // loadObj in two steps: readObj and the read*Texture functions only touch
+  // memory and may run on a worker thread; uploadGL then creates the GL
+  // objects on the GL thread
+  void readObj(std::string_view path, bool standardize = true,
+               bool packVertices = false);
+  // Which chunks each floor cell sees, traced against mesh (the maze in world
+  // space); also safe on the worker thread
+  void bakeVisibility(const CollisionMesh &mesh);
+  void readDiffuseTexture(std::string_view path);
+  void readNormalTexture(std::string_view path);
+  void uploadGL();
+
+  // Draws the chunks left by the last cull in paintGL
+  void render() const;
+  void setupVAO(const Program &program);
   void terminateGL();
-  void paintGL(GLuint m_program, glm::mat4 &viewMatrix, glm::mat4 &projMatrix, GLfloat &lightDir, GLfloat &Ia, GLfloat &Id, GLfloat &Is);
+  // Expects the FrameUniforms of this frame to be bound
+  void paintGL(Program &program, UniformStream &uniforms,
+               const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
 
   [[nodiscard]] int getNumTriangles() const
   {
@@ -45,6 +84,16 @@ public:
 
   [[nodiscard]] GLuint getCubeTexture() const { return m_cubeTexture; }
 
+  // Maze to world space
+  [[nodiscard]] glm::mat4 getModelMatrix() const
+  {
+    return glm::scale(glm::mat4{1.0f}, glm::vec3(0.20f));
+  }
+
+  // Geometry as read, for building collision data
+  [[nodiscard]] std::vector<glm::vec3> positions() const;
+  [[nodiscard]] const std::vector<GLuint> &indices() const { return m_indices; }
+
 private:
   GLuint m_VAO{};
   GLuint m_VBO{};
@@ -61,12 +110,42 @@ private:
   std::vector<Vertex> m_vertices;
   std::vector<GLuint> m_indices;
 
+  // Layout of the uploaded vertices
+  bool m_packVertices{false};
+  VertexFormat m_vertexFormat;
+  IndexLayout m_indexLayout;
+
+  // Spatial chunks of the maze and their hierarchy, culled every frame
+  static constexpr std::size_t maxChunkTriangles{128};
+  std::vector<IndexRange> m_ranges;
+  Bvh m_bvh;
+  std::vector<std::size_t> m_drawRanges;
+
+  // Chunks visible from each floor cell, checked before the frustum; eye
+  // heights cover the chase camera
+  static constexpr float visibilityCellSize{2.0f};
+  static constexpr float visibilityEyeMin{0.1f};
+  static constexpr float visibilityEyeMax{1.0f};
+  Pvs m_pvs;
+
+  // Read but not yet uploaded
+  std::vector<std::byte> m_vertexData;
+  std::optional<TextureData> m_pendingDiffuseTexture;
+  std::optional<TextureData> m_pendingNormalTexture;
+
+  glm::vec3 m_boundsMin{};
+  glm::vec3 m_boundsMax{};
+
   bool m_hasNormals{false};
   bool m_hasTexCoords{false};
 
+  void bakePlanarTexCoords();
+  void computeBounds();
   void computeNormals();
   void computeTangents();
   void createBuffers();
+  void loadFromCache(const MeshCache &cache, const std::string &basePath);
+  void prepareBuffers();
   void standardize();
 };
 
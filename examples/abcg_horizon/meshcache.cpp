@@ -0,0 +1,394 @@
+#include "meshcache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(_WIN32)
+#define MESHCACHE_USE_MMAP 0
+#else
+#define MESHCACHE_USE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  constexpr char magic[8]{'A', 'B', 'C', 'G', 'M', 'S', 'H', '\0'};
+  constexpr std::size_t dataAlignment{16};
+
+  struct FileHeader
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t options;
+    std::uint64_t sourceHash;
+    std::uint32_t vertexSize;
+    std::uint32_t flags; // bit 0: normals, bit 1: texture coordinates
+    std::uint64_t vertexCount;
+    std::uint64_t indexCount;
+    std::uint64_t vertexOffset;
+    std::uint64_t indexOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+    float Ka[4];
+    float Kd[4];
+    float Ks[4];
+    float shininess;
+    std::uint32_t diffuseTexNameSize;
+    std::uint32_t normalTexNameSize;
+    std::uint32_t rangeCount;
+    std::uint32_t lodCount;
+    std::uint32_t partCount;
+    std::uint32_t partNamesSize;
+  };
+
+  // Followed by the names of all parts, back to back
+  struct PartRecord
+  {
+    std::uint32_t nameSize;
+    float color[4];
+    float boundsMin[3];
+    float boundsMax[3];
+  };
+
+  std::size_t alignUp(std::size_t value)
+  {
+    return (value + dataAlignment - 1) / dataAlignment * dataAlignment;
+  }
+
+  std::uint64_t mix(std::uint64_t h)
+  {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // 64-bit hash consuming 8 bytes per step
+  std::uint64_t hashBytes(const std::byte *data, std::size_t size)
+  {
+    std::uint64_t h{0x9e3779b97f4a7c15ull ^ size};
+    std::size_t offset{};
+    for (; offset + 8 <= size; offset += 8)
+    {
+      std::uint64_t word;
+      std::memcpy(&word, data + offset, 8);
+      h = (h ^ mix(word)) * 0x9e3779b97f4a7c15ull;
+    }
+    std::uint64_t tail{};
+    std::memcpy(&tail, data + offset, size - offset);
+    return mix(h ^ mix(tail));
+  }
+} // namespace
+
+MeshCache::~MeshCache() { close(); }
+
+std::uint64_t MeshCache::hashFile(std::string_view path)
+{
+  MeshCache file;
+  if (!file.map(path))
+    return 0;
+  return hashBytes(file.m_data, file.m_size);
+}
+
+std::uint64_t MeshCache::hashObj(std::string_view path)
+{
+  MeshCache file;
+  if (!file.map(path))
+    return 0;
+
+  auto hash{hashBytes(file.m_data, file.m_size)};
+
+  const std::string_view text{reinterpret_cast<const char *>(file.m_data),
+                              file.m_size};
+  const auto isBlank{[](char c)
+                     { return c == ' ' || c == '\t' || c == '\r'; }};
+  const auto basePath{std::filesystem::path{path}.parent_path()};
+  constexpr std::string_view keyword{"mtllib"};
+  for (auto at{text.find(keyword)}; at != std::string_view::npos;
+       at = text.find(keyword, at + keyword.size()))
+  {
+    // Only a keyword at the start of a line
+    auto lineStart{at};
+    while (lineStart > 0 && isBlank(text[lineStart - 1]))
+      --lineStart;
+    if (lineStart > 0 && text[lineStart - 1] != '\n')
+      continue;
+
+    const auto lineEnd{std::min(text.find('\n', at), text.size())};
+    auto name{text.substr(at + keyword.size(),
+                          lineEnd - at - keyword.size())};
+    if (name.empty() || !isBlank(name.front()))
+      continue;
+    while (!name.empty() && isBlank(name.front()))
+      name.remove_prefix(1);
+    while (!name.empty() && isBlank(name.back()))
+      name.remove_suffix(1);
+
+    const auto libraryHash{hashFile((basePath / std::string{name}).string())};
+    hash = (hash ^ mix(libraryHash)) * 0x9e3779b97f4a7c15ull;
+  }
+  return mix(hash);
+}
+
+bool MeshCache::map(std::string_view path)
+{
+  close();
+
+#if MESHCACHE_USE_MMAP
+  const int fd{::open(std::string{path}.c_str(), O_RDONLY)};
+  if (fd < 0)
+    return false;
+
+  struct stat status
+  {
+  };
+  if (::fstat(fd, &status) != 0 || status.st_size <= 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void *address{::mmap(nullptr, static_cast<std::size_t>(status.st_size),
+                       PROT_READ, MAP_PRIVATE, fd, 0)};
+  ::close(fd);
+  if (address == MAP_FAILED)
+    return false;
+
+  m_data = static_cast<const std::byte *>(address);
+  m_size = static_cast<std::size_t>(status.st_size);
+  m_mapped = true;
+#else
+  std::ifstream stream{std::string{path}, std::ios::binary | std::ios::ate};
+  if (!stream)
+    return false;
+
+  m_buffer.resize(static_cast<std::size_t>(stream.tellg()));
+  stream.seekg(0);
+  if (!stream.read(reinterpret_cast<char *>(m_buffer.data()),
+                   static_cast<std::streamsize>(m_buffer.size())))
+  {
+    m_buffer.clear();
+    return false;
+  }
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+#endif
+  return true;
+}
+
+void MeshCache::close()
+{
+#if MESHCACHE_USE_MMAP
+  if (m_mapped)
+  {
+    ::munmap(const_cast<std::byte *>(m_data), m_size);
+  }
+#endif
+  m_buffer.clear();
+  m_data = nullptr;
+  m_size = 0;
+  m_mapped = false;
+}
+
+bool MeshCache::open(std::string_view path, const MeshCacheKey &key)
+{
+  if (key.sourceHash == 0 || !map(path))
+    return false;
+
+  FileHeader header{};
+  if (m_size < sizeof(header))
+  {
+    close();
+    return false;
+  }
+  std::memcpy(&header, m_data, sizeof(header));
+
+  const auto rangesOffset{sizeof(header) + header.diffuseTexNameSize +
+                          header.normalTexNameSize};
+  const auto partsOffset{rangesOffset +
+                         std::size_t{header.rangeCount} * sizeof(GLuint)};
+  const auto partNamesOffset{partsOffset + std::size_t{header.partCount} *
+                                               sizeof(PartRecord)};
+  const auto stringsEnd{partNamesOffset + header.partNamesSize};
+  const auto vertexBytes{header.vertexCount * header.vertexSize};
+  const auto indexBytes{header.indexCount * sizeof(GLuint)};
+
+  const bool valid{
+      std::memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+      header.version == version && header.options == key.options &&
+      header.sourceHash == key.sourceHash &&
+      header.vertexSize == key.vertexSize && header.lodCount >= 1 &&
+      stringsEnd <= m_size &&
+      header.vertexOffset % dataAlignment == 0 &&
+      header.indexOffset % dataAlignment == 0 &&
+      header.vertexOffset >= stringsEnd &&
+      header.vertexOffset + vertexBytes <= header.indexOffset &&
+      header.indexOffset + indexBytes <= m_size};
+  if (!valid)
+  {
+    close();
+    return false;
+  }
+
+  m_vertexOffset = header.vertexOffset;
+  m_vertexCount = header.vertexCount;
+  m_indexOffset = header.indexOffset;
+  m_indexCount = header.indexCount;
+
+  m_info.hasNormals = (header.flags & 1u) != 0;
+  m_info.hasTexCoords = (header.flags & 2u) != 0;
+  m_info.boundsMin = {header.boundsMin[0], header.boundsMin[1],
+                      header.boundsMin[2]};
+  m_info.boundsMax = {header.boundsMax[0], header.boundsMax[1],
+                      header.boundsMax[2]};
+  m_info.Ka = {header.Ka[0], header.Ka[1], header.Ka[2], header.Ka[3]};
+  m_info.Kd = {header.Kd[0], header.Kd[1], header.Kd[2], header.Kd[3]};
+  m_info.Ks = {header.Ks[0], header.Ks[1], header.Ks[2], header.Ks[3]};
+  m_info.shininess = header.shininess;
+
+  const auto *strings{reinterpret_cast<const char *>(m_data + sizeof(header))};
+  m_info.diffuseTexName.assign(strings, header.diffuseTexNameSize);
+  m_info.normalTexName.assign(strings + header.diffuseTexNameSize,
+                              header.normalTexNameSize);
+
+  m_info.rangeEnds.resize(header.rangeCount);
+  std::memcpy(m_info.rangeEnds.data(), m_data + rangesOffset,
+              m_info.rangeEnds.size() * sizeof(GLuint));
+  m_info.lodCount = header.lodCount;
+
+  m_info.parts.clear();
+  const auto *partName{
+      reinterpret_cast<const char *>(m_data + partNamesOffset)};
+  const auto *partNamesEnd{partName + header.partNamesSize};
+  for (std::uint32_t i{}; i < header.partCount; ++i)
+  {
+    PartRecord record{};
+    std::memcpy(&record, m_data + partsOffset + i * sizeof(PartRecord),
+                sizeof(record));
+    if (record.nameSize > static_cast<std::size_t>(partNamesEnd - partName))
+    {
+      close();
+      return false;
+    }
+
+    auto &part{m_info.parts.emplace_back()};
+    part.name.assign(partName, record.nameSize);
+    partName += record.nameSize;
+    part.color = {record.color[0], record.color[1], record.color[2],
+                  record.color[3]};
+    part.boundsMin = {record.boundsMin[0], record.boundsMin[1],
+                      record.boundsMin[2]};
+    part.boundsMax = {record.boundsMax[0], record.boundsMax[1],
+                      record.boundsMax[2]};
+  }
+  return true;
+}
+
+bool MeshCache::save(std::string_view path, const MeshCacheKey &key,
+                     const void *vertices, std::size_t vertexCount,
+                     const GLuint *indices, std::size_t indexCount,
+                     const MeshCacheInfo &info)
+{
+  if (key.sourceHash == 0)
+    return false;
+
+  FileHeader header{};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.options = key.options;
+  header.sourceHash = key.sourceHash;
+  header.vertexSize = key.vertexSize;
+  header.flags = (info.hasNormals ? 1u : 0u) | (info.hasTexCoords ? 2u : 0u);
+  header.vertexCount = vertexCount;
+  header.indexCount = indexCount;
+  for (const auto i : {0, 1, 2})
+  {
+    header.boundsMin[i] = info.boundsMin[i];
+    header.boundsMax[i] = info.boundsMax[i];
+  }
+  for (const auto i : {0, 1, 2, 3})
+  {
+    header.Ka[i] = info.Ka[i];
+    header.Kd[i] = info.Kd[i];
+    header.Ks[i] = info.Ks[i];
+  }
+  header.shininess = info.shininess;
+  header.diffuseTexNameSize =
+      static_cast<std::uint32_t>(info.diffuseTexName.size());
+  header.normalTexNameSize =
+      static_cast<std::uint32_t>(info.normalTexName.size());
+  header.rangeCount = static_cast<std::uint32_t>(info.rangeEnds.size());
+  header.lodCount = info.lodCount;
+  header.partCount = static_cast<std::uint32_t>(info.parts.size());
+
+  std::vector<PartRecord> parts;
+  std::string partNames;
+  for (const auto &part : info.parts)
+  {
+    auto &record{parts.emplace_back()};
+    record.nameSize = static_cast<std::uint32_t>(part.name.size());
+    for (const auto i : {0, 1, 2, 3})
+      record.color[i] = part.color[i];
+    for (const auto i : {0, 1, 2})
+    {
+      record.boundsMin[i] = part.boundsMin[i];
+      record.boundsMax[i] = part.boundsMax[i];
+    }
+    partNames += part.name;
+  }
+  header.partNamesSize = static_cast<std::uint32_t>(partNames.size());
+
+  const auto vertexBytes{vertexCount * key.vertexSize};
+  header.vertexOffset = alignUp(
+      sizeof(header) + header.diffuseTexNameSize + header.normalTexNameSize +
+      header.rangeCount * sizeof(GLuint) +
+      header.partCount * sizeof(PartRecord) + header.partNamesSize);
+  header.indexOffset = alignUp(header.vertexOffset + vertexBytes);
+
+  // Write to a temporary file first so that readers never see a partial cache
+  const std::string finalPath{path};
+  const auto temporaryPath{finalPath + ".tmp"};
+  {
+    std::ofstream stream{temporaryPath, std::ios::binary | std::ios::trunc};
+    if (!stream)
+      return false;
+
+    const auto pad{[&stream](std::size_t offset)
+                   {
+                     const char zeros[dataAlignment]{};
+                     const auto position{static_cast<std::size_t>(stream.tellp())};
+                     stream.write(zeros, static_cast<std::streamsize>(
+                                             offset - position));
+                   }};
+
+    stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    stream.write(info.diffuseTexName.data(), header.diffuseTexNameSize);
+    stream.write(info.normalTexName.data(), header.normalTexNameSize);
+    stream.write(reinterpret_cast<const char *>(info.rangeEnds.data()),
+                 static_cast<std::streamsize>(header.rangeCount *
+                                              sizeof(GLuint)));
+    stream.write(reinterpret_cast<const char *>(parts.data()),
+                 static_cast<std::streamsize>(header.partCount *
+                                              sizeof(PartRecord)));
+    stream.write(partNames.data(), header.partNamesSize);
+    pad(header.vertexOffset);
+    stream.write(static_cast<const char *>(vertices),
+                 static_cast<std::streamsize>(vertexBytes));
+    pad(header.indexOffset);
+    stream.write(reinterpret_cast<const char *>(indices),
+                 static_cast<std::streamsize>(indexCount * sizeof(GLuint)));
+    if (!stream)
+      return false;
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporaryPath, finalPath, error);
+  return !error;
+}
@@ -0,0 +1,137 @@
+#ifndef MESHCACHE_HPP_
+#define MESHCACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "abcg.hpp"
+
+// Identifies the mesh produced by a given source file, its material libraries
+// and load options
+struct MeshCacheKey
+{
+  // Bits of options
+  static constexpr std::uint32_t standardized{1u << 0};
+
+  std::uint64_t sourceHash{};
+  std::uint32_t options{};
+  std::uint32_t vertexSize{};
+};
+
+// Named part of a mesh, one per submesh of the source file
+struct MeshPart
+{
+  std::string name;
+  glm::vec4 color{};
+  glm::vec3 boundsMin{};
+  glm::vec3 boundsMax{};
+};
+
+// Everything besides vertices and indices that loadObj would recompute
+struct MeshCacheInfo
+{
+  bool hasNormals{false};
+  bool hasTexCoords{false};
+
+  glm::vec3 boundsMin{};
+  glm::vec3 boundsMax{};
+
+  glm::vec4 Ka{};
+  glm::vec4 Kd{};
+  glm::vec4 Ks{};
+  float shininess{};
+  std::string diffuseTexName;
+  std::string normalTexName;
+
+  // End of each index range (parts of every level of detail, level after
+  // level); empty when the mesh is drawn as a single range
+  std::vector<GLuint> rangeEnds;
+  std::uint32_t lodCount{1};
+
+  // One per range of the first level of detail
+  std::vector<MeshPart> parts;
+};
+
+// Versioned binary cache of a post-processed mesh (deduplicated vertices,
+// indices, normals, tangents, bounds, index ranges, parts and material). A
+// cache file is memory-mapped on open, so a hit skips parsing, welding and
+// normal/tangent generation. The arrays it holds are the unpacked ones:
+// loaders copy them out with copyTo() and still pack vertices (VertexFormat)
+// and narrow indices (IndexLayout) before uploading.
+class MeshCache
+{
+public:
+  // Bump whenever the file layout or the load pipeline changes
+  static constexpr std::uint32_t version{10};
+
+  MeshCache() = default;
+  MeshCache(const MeshCache &) = delete;
+  MeshCache &operator=(const MeshCache &) = delete;
+  ~MeshCache();
+
+  [[nodiscard]] static std::string cachePath(std::string_view sourcePath)
+  {
+    return std::string{sourcePath} + ".meshcache";
+  }
+  [[nodiscard]] static std::uint64_t hashFile(std::string_view path);
+  // Hash of an OBJ file and of the material libraries it references, since
+  // the cache stores their materials too
+  [[nodiscard]] static std::uint64_t hashObj(std::string_view path);
+
+  bool open(std::string_view path, const MeshCacheKey &key);
+  static bool save(std::string_view path, const MeshCacheKey &key,
+                   const void *vertices, std::size_t vertexCount,
+                   const GLuint *indices, std::size_t indexCount,
+                   const MeshCacheInfo &info);
+
+  template <typename V>
+  static bool save(std::string_view path, const MeshCacheKey &key,
+                   const std::vector<V> &vertices,
+                   const std::vector<GLuint> &indices,
+                   const MeshCacheInfo &info)
+  {
+    return save(path, key, vertices.data(), vertices.size(), indices.data(),
+                indices.size(), info);
+  }
+
+  // Bulk copies of the mapped arrays
+  template <typename V> void copyTo(std::vector<V> &vertices,
+                                    std::vector<GLuint> &indices) const
+  {
+    const auto *firstVertex{static_cast<const V *>(vertexData())};
+    vertices.assign(firstVertex, firstVertex + m_vertexCount);
+    indices.assign(indexData(), indexData() + m_indexCount);
+  }
+
+  [[nodiscard]] const void *vertexData() const
+  {
+    return m_data + m_vertexOffset;
+  }
+  [[nodiscard]] const GLuint *indexData() const
+  {
+    return reinterpret_cast<const GLuint *>(m_data + m_indexOffset);
+  }
+  [[nodiscard]] std::size_t vertexCount() const { return m_vertexCount; }
+  [[nodiscard]] std::size_t indexCount() const { return m_indexCount; }
+  [[nodiscard]] const MeshCacheInfo &info() const { return m_info; }
+
+private:
+  const std::byte *m_data{};
+  std::size_t m_size{};
+  bool m_mapped{false};
+  std::vector<std::byte> m_buffer; // Used where mmap is unavailable
+
+  std::size_t m_vertexOffset{};
+  std::size_t m_vertexCount{};
+  std::size_t m_indexOffset{};
+  std::size_t m_indexCount{};
+  MeshCacheInfo m_info;
+
+  void close();
+  bool map(std::string_view path);
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "meshkernels.hpp"
+
+#include <fmt/core.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <string_view>
+#include <type_traits>
+
+#include "meshkernels_simd.hpp"
+#include "parallel.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+static_assert(std::is_same_v<GLuint, std::uint32_t>);
+
+KernelTable scalarKernels() { return makeKernelTable<Scalar>("scalar"); }
+
+namespace
+{
+  struct CpuFeatures
+  {
+    bool sse41{};
+    bool avx2{};
+  };
+
+  CpuFeatures detectCpuFeatures()
+  {
+    CpuFeatures features;
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    features.sse41 = __builtin_cpu_supports("sse4.1");
+    features.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    std::array<int, 4> info{};
+    __cpuid(info.data(), 0);
+    const auto maxLeaf{info[0]};
+    __cpuid(info.data(), 1);
+    features.sse41 = (info[2] & (1 << 19)) != 0;
+    // AVX also needs the OS to save the YMM registers
+    const auto osxsave{(info[2] & (1 << 27)) != 0};
+    const auto avx{(info[2] & (1 << 28)) != 0};
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+    {
+      __cpuidex(info.data(), 7, 0);
+      features.avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#endif
+    return features;
+  }
+
+  KernelTable selectKernels()
+  {
+    const auto features{detectCpuFeatures()};
+    const auto avx2{avx2Kernels()};
+    const auto sse41{sse41Kernels()};
+
+    std::string_view forced;
+    if (const auto *env{std::getenv("ABCG_MESH_KERNELS")})
+      forced = env;
+
+    if (forced == "scalar")
+      return scalarKernels();
+    if (forced == "sse4.1" && features.sse41 && sse41.name != nullptr)
+      return sse41;
+    if (forced == "avx2" && features.avx2 && avx2.name != nullptr)
+      return avx2;
+    if (!forced.empty())
+      fmt::print("ABCG_MESH_KERNELS={} is not available on this CPU\n",
+                 forced);
+
+    if (features.avx2 && avx2.name != nullptr)
+      return avx2;
+    if (features.sse41 && sse41.name != nullptr)
+      return sse41;
+    return scalarKernels();
+  }
+
+  const KernelTable &kernels()
+  {
+    static const auto table{selectKernels()};
+    return table;
+  }
+
+  // Elements per worker below which threads cost more than they save
+  constexpr std::size_t minChunkSize{64 * 1024};
+
+  // Triangles around each vertex, in ascending order. Summing face values
+  // through this instead of scattering them lets vertices be split across
+  // threads, and gives the same sums as the serial scatter for any number of
+  // threads.
+  struct VertexTriangles
+  {
+    std::vector<std::size_t> offsets;
+    std::vector<GLuint> triangles;
+  };
+
+  VertexTriangles vertexTriangles(const std::vector<GLuint> &indices,
+                                  std::size_t vertexCount)
+  {
+    VertexTriangles around;
+    around.offsets.assign(vertexCount + 1, 0);
+    for (const auto index : indices)
+      ++around.offsets[index + 1];
+    std::partial_sum(around.offsets.begin(), around.offsets.end(),
+                     around.offsets.begin());
+
+    around.triangles.resize(indices.size());
+    auto fill{around.offsets};
+    for (std::size_t corner{}; corner < indices.size(); ++corner)
+      around.triangles[fill[indices[corner]]++] =
+          static_cast<GLuint>(corner / 3);
+    return around;
+  }
+} // namespace
+
+const char *meshKernelsName() { return kernels().name; }
+
+void computeBounds(const VertexStreams &streams, glm::vec3 &min,
+                   glm::vec3 &max)
+{
+  std::array<float, 3> lower;
+  std::array<float, 3> upper;
+  lower.fill(std::numeric_limits<float>::max());
+  upper.fill(std::numeric_limits<float>::lowest());
+  kernels().bounds(streams.x.data(), streams.y.data(), streams.z.data(),
+                   streams.x.size(), lower.data(), upper.data());
+  min = {lower[0], lower[1], lower[2]};
+  max = {upper[0], upper[1], upper[2]};
+}
+
+void standardize(VertexStreams &streams)
+{
+  glm::vec3 min{};
+  glm::vec3 max{};
+  computeBounds(streams, min, max);
+
+  const auto center{(min + max) / 2.0f};
+  const auto scaling{2.0f / glm::length(max - min)};
+  kernels().centerAndScale(streams.x.data(), streams.y.data(),
+                           streams.z.data(), streams.x.size(), &center.x,
+                           scaling);
+}
+
+void computeNormals(VertexStreams &streams, const std::vector<GLuint> &indices,
+                    std::size_t numThreads)
+{
+  const auto &table{kernels()};
+  const auto vertexCount{streams.x.size()};
+  const auto triangleCount{indices.size() / 3};
+
+  std::vector<float> faceX(triangleCount);
+  std::vector<float> faceY(triangleCount);
+  std::vector<float> faceZ(triangleCount);
+  parallelFor(triangleCount, numThreads, minChunkSize,
+              [&](std::size_t first, std::size_t last)
+              {
+                table.faceNormals(streams.x.data(), streams.y.data(),
+                                  streams.z.data(), indices.data() + first * 3,
+                                  last - first, faceX.data() + first,
+                                  faceY.data() + first, faceZ.data() + first);
+              });
+
+  const auto around{vertexTriangles(indices, vertexCount)};
+  streams.nx.resize(vertexCount);
+  streams.ny.resize(vertexCount);
+  streams.nz.resize(vertexCount);
+  parallelFor(vertexCount, numThreads, minChunkSize,
+              [&](std::size_t first, std::size_t last)
+              {
+                for (auto vertex{first}; vertex < last; ++vertex)
+                {
+                  float x{};
+                  float y{};
+                  float z{};
+                  for (auto k{around.offsets[vertex]};
+                       k < around.offsets[vertex + 1]; ++k)
+                  {
+                    const auto triangle{around.triangles[k]};
+                    x += faceX[triangle];
+                    y += faceY[triangle];
+                    z += faceZ[triangle];
+                  }
+                  streams.nx[vertex] = x;
+                  streams.ny[vertex] = y;
+                  streams.nz[vertex] = z;
+                }
+                table.normalize(streams.nx.data() + first,
+                                streams.ny.data() + first,
+                                streams.nz.data() + first, last - first);
+              });
+}
+
+std::vector<glm::vec4> computeTangents(const VertexStreams &streams,
+                                       const std::vector<GLuint> &indices,
+                                       std::size_t numThreads)
+{
+  const auto &table{kernels()};
+  const auto vertexCount{streams.x.size()};
+  const auto triangleCount{indices.size() / 3};
+
+  // Tangents in 0-2, bitangents in 3-5
+  std::array<std::vector<float>, 6> face;
+  for (auto &component : face)
+    component.resize(triangleCount);
+  parallelFor(triangleCount, numThreads, minChunkSize,
+              [&](std::size_t first, std::size_t last)
+              {
+                table.faceTangents(
+                    streams.x.data(), streams.y.data(), streams.z.data(),
+                    streams.u.data(), streams.v.data(),
+                    indices.data() + first * 3, last - first,
+                    face[0].data() + first, face[1].data() + first,
+                    face[2].data() + first, face[3].data() + first,
+                    face[4].data() + first, face[5].data() + first);
+              });
+
+  const auto around{vertexTriangles(indices, vertexCount)};
+  std::array<std::vector<float>, 6> sum;
+  for (auto &component : sum)
+    component.resize(vertexCount);
+  std::vector<float> handedness(vertexCount);
+  std::vector<glm::vec4> tangents(vertexCount);
+  parallelFor(
+      vertexCount, numThreads, minChunkSize,
+      [&](std::size_t first, std::size_t last)
+      {
+        for (auto vertex{first}; vertex < last; ++vertex)
+        {
+          std::array<float, 6> total{};
+          for (auto k{around.offsets[vertex]}; k < around.offsets[vertex + 1];
+               ++k)
+          {
+            const auto triangle{around.triangles[k]};
+            for (std::size_t component{}; component < 6; ++component)
+              total[component] += face[component][triangle];
+          }
+          for (std::size_t component{}; component < 6; ++component)
+            sum[component][vertex] = total[component];
+        }
+
+        table.orthogonalize(
+            streams.nx.data() + first, streams.ny.data() + first,
+            streams.nz.data() + first, sum[0].data() + first,
+            sum[1].data() + first, sum[2].data() + first,
+            sum[3].data() + first, sum[4].data() + first,
+            sum[5].data() + first, handedness.data() + first, last - first);
+
+        for (auto vertex{first}; vertex < last; ++vertex)
+          tangents[vertex] = {sum[0][vertex], sum[1][vertex], sum[2][vertex],
+                              handedness[vertex]};
+      });
+  return tangents;
+}
@@ -0,0 +1,122 @@
+#ifndef MESHKERNELS_HPP_
+#define MESHKERNELS_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "abcg.hpp"
+
+// Vertex attributes split into one array per component, the layout the SIMD
+// kernels work on
+struct VertexStreams
+{
+  std::vector<float> x, y, z;
+  std::vector<float> nx, ny, nz;
+  std::vector<float> u, v;
+};
+
+// Instruction set the kernels run with: "AVX2", "SSE4.1" or "scalar". It is
+// picked from the CPU on first use and can be forced with the
+// ABCG_MESH_KERNELS environment variable (avx2, sse4.1 or scalar).
+[[nodiscard]] const char *meshKernelsName();
+
+void computeBounds(const VertexStreams &streams, glm::vec3 &min,
+                   glm::vec3 &max);
+
+// Centers positions at the origin and scales the bounding box diagonal to 2
+void standardize(VertexStreams &streams);
+
+// Area-weighted vertex normals; overwrites nx, ny and nz. Runs on numThreads
+// workers (0 picks the number of hardware threads) and gives the same result
+// for any number of them.
+void computeNormals(VertexStreams &streams, const std::vector<GLuint> &indices,
+                    std::size_t numThreads = 0);
+
+// Tangents orthogonalized against the normals, with the handedness of the
+// tangent frame in w. Needs normals and texture coordinates. Threads as in
+// computeNormals.
+[[nodiscard]] std::vector<glm::vec4>
+computeTangents(const VertexStreams &streams,
+                const std::vector<GLuint> &indices, std::size_t numThreads = 0);
+
+// Wrappers for vertex types with position, normal, texCoord and tangent
+// members
+template <typename V>
+[[nodiscard]] VertexStreams toStreams(const std::vector<V> &vertices,
+                                      bool normals, bool texCoords)
+{
+  VertexStreams streams;
+  const auto count{vertices.size()};
+  streams.x.resize(count);
+  streams.y.resize(count);
+  streams.z.resize(count);
+  if (normals)
+  {
+    streams.nx.resize(count);
+    streams.ny.resize(count);
+    streams.nz.resize(count);
+  }
+  if (texCoords)
+  {
+    streams.u.resize(count);
+    streams.v.resize(count);
+  }
+  for (std::size_t i{}; i < count; ++i)
+  {
+    const auto &vertex{vertices[i]};
+    streams.x[i] = vertex.position.x;
+    streams.y[i] = vertex.position.y;
+    streams.z[i] = vertex.position.z;
+    if (normals)
+    {
+      streams.nx[i] = vertex.normal.x;
+      streams.ny[i] = vertex.normal.y;
+      streams.nz[i] = vertex.normal.z;
+    }
+    if (texCoords)
+    {
+      streams.u[i] = vertex.texCoord.x;
+      streams.v[i] = vertex.texCoord.y;
+    }
+  }
+  return streams;
+}
+
+template <typename V>
+void computeBounds(const std::vector<V> &vertices, glm::vec3 &min,
+                   glm::vec3 &max)
+{
+  computeBounds(toStreams(vertices, false, false), min, max);
+}
+
+template <typename V> void standardize(std::vector<V> &vertices)
+{
+  auto streams{toStreams(vertices, false, false)};
+  standardize(streams);
+  for (std::size_t i{}; i < vertices.size(); ++i)
+    vertices[i].position = {streams.x[i], streams.y[i], streams.z[i]};
+}
+
+template <typename V>
+void computeNormals(std::vector<V> &vertices,
+                    const std::vector<GLuint> &indices,
+                    std::size_t numThreads = 0)
+{
+  auto streams{toStreams(vertices, false, false)};
+  computeNormals(streams, indices, numThreads);
+  for (std::size_t i{}; i < vertices.size(); ++i)
+    vertices[i].normal = {streams.nx[i], streams.ny[i], streams.nz[i]};
+}
+
+template <typename V>
+void computeTangents(std::vector<V> &vertices,
+                     const std::vector<GLuint> &indices,
+                     std::size_t numThreads = 0)
+{
+  const auto tangents{
+      computeTangents(toStreams(vertices, true, true), indices, numThreads)};
+  for (std::size_t i{}; i < vertices.size(); ++i)
+    vertices[i].tangent = tangents[i];
+}
+
+#endif
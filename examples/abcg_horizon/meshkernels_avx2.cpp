@@ -0,0 +1,57 @@
+// AVX2 mesh kernels; built with -mavx2 on x86 (see CMakeLists.txt)
+
+#include "meshkernels_simd.hpp"
+
+#if defined(__AVX2__)
+#define MESHKERNELS_HAS_AVX2 1
+#include <immintrin.h>
+#else
+#define MESHKERNELS_HAS_AVX2 0
+#endif
+
+#if MESHKERNELS_HAS_AVX2
+namespace
+{
+  struct Avx2
+  {
+    using F = __m256;
+    using I = __m256i;
+    static constexpr std::size_t width{8};
+
+    static F load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, F a) { _mm256_storeu_ps(p, a); }
+    static F set1(float a) { return _mm256_set1_ps(a); }
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+
+    static F sign(F a)
+    {
+      const auto negative{_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ)};
+      return _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_set1_ps(-1.0f),
+                              negative);
+    }
+
+    // Same corner of eight consecutive triangles
+    static I corners(const std::uint32_t *indices)
+    {
+      const auto stride{_mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21)};
+      return _mm256_i32gather_epi32(reinterpret_cast<const int *>(indices),
+                                    stride, 4);
+    }
+
+    static F gather(const float *base, I index)
+    {
+      return _mm256_i32gather_ps(base, index, 4);
+    }
+  };
+} // namespace
+
+KernelTable avx2Kernels() { return makeKernelTable<Avx2>("AVX2"); }
+#else
+KernelTable avx2Kernels() { return KernelTable{}; }
+#endif
@@ -0,0 +1,322 @@
+#ifndef MESHKERNELS_SIMD_HPP_
+#define MESHKERNELS_SIMD_HPP_
+
+// Bodies of the mesh kernels behind meshkernels.hpp, written once against a vector type S that
+// provides width, load/store, arithmetic and gathers. Each instruction set
+// has its own translation unit that defines S and fills a KernelTable.
+//
+// Everything here lives in an unnamed namespace and uses only plain loops:
+// an inline function shared with other translation units could be emitted
+// with AVX2 instructions and then picked by the linker for every caller.
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <math.h>
+#endif
+
+// Entry points of one instruction set; a null name means it is unavailable.
+// Kept an aggregate without initializers so that no constructor is shared
+// between the translation units.
+struct KernelTable
+{
+  const char *name;
+
+  void (*bounds)(const float *x, const float *y, const float *z,
+                 std::size_t count, float *min, float *max);
+  void (*centerAndScale)(float *x, float *y, float *z, std::size_t count,
+                         const float *center, float scale);
+  void (*faceNormals)(const float *x, const float *y, const float *z,
+                      const std::uint32_t *indices, std::size_t triangleCount,
+                      float *nx, float *ny, float *nz);
+  void (*normalize)(float *x, float *y, float *z, std::size_t count);
+  void (*faceTangents)(const float *x, const float *y, const float *z,
+                       const float *u, const float *v,
+                       const std::uint32_t *indices, std::size_t triangleCount,
+                       float *tx, float *ty, float *tz, float *bx, float *by,
+                       float *bz);
+  void (*orthogonalize)(const float *nx, const float *ny, const float *nz,
+                        float *tx, float *ty, float *tz, const float *bx,
+                        const float *by, const float *bz, float *handedness,
+                        std::size_t count);
+};
+
+namespace
+{
+  // One lane; also finishes the elements left over by the wider types
+  struct Scalar
+  {
+    using F = float;
+    using I = std::uint32_t;
+    static constexpr std::size_t width{1};
+
+    static F load(const float *p) { return *p; }
+    static void store(float *p, F a) { *p = a; }
+    static F set1(float a) { return a; }
+    static F add(F a, F b) { return a + b; }
+    static F sub(F a, F b) { return a - b; }
+    static F mul(F a, F b) { return a * b; }
+    static F div(F a, F b) { return a / b; }
+    static F min(F a, F b) { return b < a ? b : a; }
+    static F max(F a, F b) { return a < b ? b : a; }
+#if defined(_MSC_VER) && !defined(__clang__)
+    static F sqrt(F a) { return ::sqrtf(a); }
+#else
+    static F sqrt(F a) { return __builtin_sqrtf(a); }
+#endif
+    static F sign(F a) { return a < 0.0f ? -1.0f : 1.0f; }
+    static I corners(const std::uint32_t *indices) { return *indices; }
+    static F gather(const float *base, I index) { return base[index]; }
+  };
+
+  template <typename S>
+  typename S::F dot(typename S::F ax, typename S::F ay, typename S::F az,
+                    typename S::F bx, typename S::F by, typename S::F bz)
+  {
+    return S::add(S::add(S::mul(ax, bx), S::mul(ay, by)), S::mul(az, bz));
+  }
+
+  template <typename S>
+  void bounds(const float *x, const float *y, const float *z,
+              std::size_t count, float *min, float *max)
+  {
+    std::size_t i{};
+    if constexpr (S::width > 1)
+    {
+      if (count >= S::width)
+      {
+        auto minX{S::load(x)};
+        auto minY{S::load(y)};
+        auto minZ{S::load(z)};
+        auto maxX{minX};
+        auto maxY{minY};
+        auto maxZ{minZ};
+        for (i = S::width; i + S::width <= count; i += S::width)
+        {
+          const auto px{S::load(x + i)};
+          const auto py{S::load(y + i)};
+          const auto pz{S::load(z + i)};
+          minX = S::min(minX, px);
+          minY = S::min(minY, py);
+          minZ = S::min(minZ, pz);
+          maxX = S::max(maxX, px);
+          maxY = S::max(maxY, py);
+          maxZ = S::max(maxZ, pz);
+        }
+
+        float lanes[6][S::width];
+        S::store(lanes[0], minX);
+        S::store(lanes[1], minY);
+        S::store(lanes[2], minZ);
+        S::store(lanes[3], maxX);
+        S::store(lanes[4], maxY);
+        S::store(lanes[5], maxZ);
+        for (std::size_t lane{}; lane < S::width; ++lane)
+        {
+          for (std::size_t axis{}; axis < 3; ++axis)
+          {
+            min[axis] = Scalar::min(min[axis], lanes[axis][lane]);
+            max[axis] = Scalar::max(max[axis], lanes[axis + 3][lane]);
+          }
+        }
+      }
+    }
+    for (; i < count; ++i)
+    {
+      min[0] = Scalar::min(min[0], x[i]);
+      min[1] = Scalar::min(min[1], y[i]);
+      min[2] = Scalar::min(min[2], z[i]);
+      max[0] = Scalar::max(max[0], x[i]);
+      max[1] = Scalar::max(max[1], y[i]);
+      max[2] = Scalar::max(max[2], z[i]);
+    }
+  }
+
+  template <typename S>
+  void centerAndScale(float *x, float *y, float *z, std::size_t count,
+                      const float *center, float scale)
+  {
+    const auto cx{S::set1(center[0])};
+    const auto cy{S::set1(center[1])};
+    const auto cz{S::set1(center[2])};
+    const auto s{S::set1(scale)};
+    std::size_t i{};
+    for (; i + S::width <= count; i += S::width)
+    {
+      S::store(x + i, S::mul(S::sub(S::load(x + i), cx), s));
+      S::store(y + i, S::mul(S::sub(S::load(y + i), cy), s));
+      S::store(z + i, S::mul(S::sub(S::load(z + i), cz), s));
+    }
+    if constexpr (S::width > 1)
+      centerAndScale<Scalar>(x + i, y + i, z + i, count - i, center, scale);
+  }
+
+  // Unnormalized cross(b - a, c - b) of each triangle
+  template <typename S>
+  void faceNormals(const float *x, const float *y, const float *z,
+                   const std::uint32_t *indices, std::size_t triangleCount,
+                   float *nx, float *ny, float *nz)
+  {
+    std::size_t t{};
+    for (; t + S::width <= triangleCount; t += S::width)
+    {
+      const auto *corners{indices + t * 3};
+      const auto ia{S::corners(corners + 0)};
+      const auto ib{S::corners(corners + 1)};
+      const auto ic{S::corners(corners + 2)};
+
+      const auto ax{S::gather(x, ia)};
+      const auto ay{S::gather(y, ia)};
+      const auto az{S::gather(z, ia)};
+      const auto bx{S::gather(x, ib)};
+      const auto by{S::gather(y, ib)};
+      const auto bz{S::gather(z, ib)};
+      const auto cx{S::gather(x, ic)};
+      const auto cy{S::gather(y, ic)};
+      const auto cz{S::gather(z, ic)};
+
+      const auto e1x{S::sub(bx, ax)};
+      const auto e1y{S::sub(by, ay)};
+      const auto e1z{S::sub(bz, az)};
+      const auto e2x{S::sub(cx, bx)};
+      const auto e2y{S::sub(cy, by)};
+      const auto e2z{S::sub(cz, bz)};
+
+      S::store(nx + t, S::sub(S::mul(e1y, e2z), S::mul(e1z, e2y)));
+      S::store(ny + t, S::sub(S::mul(e1z, e2x), S::mul(e1x, e2z)));
+      S::store(nz + t, S::sub(S::mul(e1x, e2y), S::mul(e1y, e2x)));
+    }
+    if constexpr (S::width > 1)
+      faceNormals<Scalar>(x, y, z, indices + t * 3, triangleCount - t, nx + t,
+                          ny + t, nz + t);
+  }
+
+  template <typename S>
+  void normalize(float *x, float *y, float *z, std::size_t count)
+  {
+    std::size_t i{};
+    for (; i + S::width <= count; i += S::width)
+    {
+      const auto px{S::load(x + i)};
+      const auto py{S::load(y + i)};
+      const auto pz{S::load(z + i)};
+      const auto length{S::sqrt(dot<S>(px, py, pz, px, py, pz))};
+      S::store(x + i, S::div(px, length));
+      S::store(y + i, S::div(py, length));
+      S::store(z + i, S::div(pz, length));
+    }
+    if constexpr (S::width > 1)
+      normalize<Scalar>(x + i, y + i, z + i, count - i);
+  }
+
+  // Tangent and bitangent of each triangle from its UV gradients
+  template <typename S>
+  void faceTangents(const float *x, const float *y, const float *z,
+                    const float *u, const float *v,
+                    const std::uint32_t *indices, std::size_t triangleCount,
+                    float *tx, float *ty, float *tz, float *bx, float *by,
+                    float *bz)
+  {
+    std::size_t t{};
+    for (; t + S::width <= triangleCount; t += S::width)
+    {
+      const auto *corners{indices + t * 3};
+      const auto i1{S::corners(corners + 0)};
+      const auto i2{S::corners(corners + 1)};
+      const auto i3{S::corners(corners + 2)};
+
+      const auto x1{S::gather(x, i1)};
+      const auto y1{S::gather(y, i1)};
+      const auto z1{S::gather(z, i1)};
+      const auto e1x{S::sub(S::gather(x, i2), x1)};
+      const auto e1y{S::sub(S::gather(y, i2), y1)};
+      const auto e1z{S::sub(S::gather(z, i2), z1)};
+      const auto e2x{S::sub(S::gather(x, i3), x1)};
+      const auto e2y{S::sub(S::gather(y, i3), y1)};
+      const auto e2z{S::sub(S::gather(z, i3), z1)};
+
+      const auto u1{S::gather(u, i1)};
+      const auto v1{S::gather(v, i1)};
+      const auto d1s{S::sub(S::gather(u, i2), u1)};
+      const auto d1t{S::sub(S::gather(v, i2), v1)};
+      const auto d2s{S::sub(S::gather(u, i3), u1)};
+      const auto d2t{S::sub(S::gather(v, i3), v1)};
+
+      const auto r{S::div(S::set1(1.0f),
+                          S::sub(S::mul(d1s, d2t), S::mul(d2s, d1t)))};
+      const auto m00{S::mul(d2t, r)};
+      const auto m01{S::mul(S::sub(S::set1(0.0f), d1t), r)};
+      const auto m10{S::mul(S::sub(S::set1(0.0f), d2s), r)};
+      const auto m11{S::mul(d1s, r)};
+
+      S::store(tx + t, S::add(S::mul(m00, e1x), S::mul(m01, e2x)));
+      S::store(ty + t, S::add(S::mul(m00, e1y), S::mul(m01, e2y)));
+      S::store(tz + t, S::add(S::mul(m00, e1z), S::mul(m01, e2z)));
+      S::store(bx + t, S::add(S::mul(m10, e1x), S::mul(m11, e2x)));
+      S::store(by + t, S::add(S::mul(m10, e1y), S::mul(m11, e2y)));
+      S::store(bz + t, S::add(S::mul(m10, e1z), S::mul(m11, e2z)));
+    }
+    if constexpr (S::width > 1)
+      faceTangents<Scalar>(x, y, z, u, v, indices + t * 3, triangleCount - t,
+                           tx + t, ty + t, tz + t, bx + t, by + t, bz + t);
+  }
+
+  // Gram-Schmidt against the normal, plus the handedness of the frame
+  template <typename S>
+  void orthogonalize(const float *nx, const float *ny, const float *nz,
+                     float *tx, float *ty, float *tz, const float *bx,
+                     const float *by, const float *bz, float *handedness,
+                     std::size_t count)
+  {
+    std::size_t i{};
+    for (; i + S::width <= count; i += S::width)
+    {
+      const auto ax{S::load(nx + i)};
+      const auto ay{S::load(ny + i)};
+      const auto az{S::load(nz + i)};
+      const auto px{S::load(tx + i)};
+      const auto py{S::load(ty + i)};
+      const auto pz{S::load(tz + i)};
+
+      const auto d{dot<S>(ax, ay, az, px, py, pz)};
+      const auto ox{S::sub(px, S::mul(ax, d))};
+      const auto oy{S::sub(py, S::mul(ay, d))};
+      const auto oz{S::sub(pz, S::mul(az, d))};
+      const auto length{S::sqrt(dot<S>(ox, oy, oz, ox, oy, oz))};
+
+      const auto cx{S::sub(S::mul(ay, pz), S::mul(az, py))};
+      const auto cy{S::sub(S::mul(az, px), S::mul(ax, pz))};
+      const auto cz{S::sub(S::mul(ax, py), S::mul(ay, px))};
+      const auto h{dot<S>(cx, cy, cz, S::load(bx + i), S::load(by + i),
+                          S::load(bz + i))};
+
+      S::store(tx + i, S::div(ox, length));
+      S::store(ty + i, S::div(oy, length));
+      S::store(tz + i, S::div(oz, length));
+      S::store(handedness + i, S::sign(h));
+    }
+    if constexpr (S::width > 1)
+      orthogonalize<Scalar>(nx + i, ny + i, nz + i, tx + i, ty + i, tz + i,
+                            bx + i, by + i, bz + i, handedness + i, count - i);
+  }
+
+  template <typename S> KernelTable makeKernelTable(const char *name)
+  {
+    KernelTable table{};
+    table.name = name;
+    table.bounds = &bounds<S>;
+    table.centerAndScale = &centerAndScale<S>;
+    table.faceNormals = &faceNormals<S>;
+    table.normalize = &normalize<S>;
+    table.faceTangents = &faceTangents<S>;
+    table.orthogonalize = &orthogonalize<S>;
+    return table;
+  }
+} // namespace
+
+KernelTable scalarKernels();
+KernelTable sse41Kernels();
+KernelTable avx2Kernels();
+
+#endif
@@ -0,0 +1,61 @@
+// SSE4.1 mesh kernels; built with -msse4.1 on x86 (see CMakeLists.txt)
+
+#include "meshkernels_simd.hpp"
+
+#if defined(__SSE4_1__) ||                                                     \
+    (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+#define MESHKERNELS_HAS_SSE41 1
+#include <smmintrin.h>
+#else
+#define MESHKERNELS_HAS_SSE41 0
+#endif
+
+#if MESHKERNELS_HAS_SSE41
+namespace
+{
+  struct Sse41
+  {
+    using F = __m128;
+    using I = __m128i;
+    static constexpr std::size_t width{4};
+
+    static F load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, F a) { _mm_storeu_ps(p, a); }
+    static F set1(float a) { return _mm_set1_ps(a); }
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm_div_ps(a, b); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F sqrt(F a) { return _mm_sqrt_ps(a); }
+
+    static F sign(F a)
+    {
+      const auto negative{_mm_cmplt_ps(a, _mm_setzero_ps())};
+      return _mm_blendv_ps(_mm_set1_ps(1.0f), _mm_set1_ps(-1.0f), negative);
+    }
+
+    // Same corner of four consecutive triangles
+    static I corners(const std::uint32_t *indices)
+    {
+      return _mm_setr_epi32(static_cast<int>(indices[0]),
+                            static_cast<int>(indices[3]),
+                            static_cast<int>(indices[6]),
+                            static_cast<int>(indices[9]));
+    }
+
+    static F gather(const float *base, I index)
+    {
+      return _mm_setr_ps(base[_mm_extract_epi32(index, 0)],
+                         base[_mm_extract_epi32(index, 1)],
+                         base[_mm_extract_epi32(index, 2)],
+                         base[_mm_extract_epi32(index, 3)]);
+    }
+  };
+} // namespace
+
+KernelTable sse41Kernels() { return makeKernelTable<Sse41>("SSE4.1"); }
+#else
+KernelTable sse41Kernels() { return KernelTable{}; }
+#endif
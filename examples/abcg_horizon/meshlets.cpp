@@ -0,0 +1,291 @@
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+  constexpr std::size_t maxShortVertices{65536};
+
+  template <typename T>
+  std::vector<std::byte> toBytes(const std::vector<T> &values)
+  {
+    std::vector<std::byte> bytes(values.size() * sizeof(T));
+    std::memcpy(bytes.data(), values.data(), bytes.size());
+    return bytes;
+  }
+
+  void computeBounds(Meshlet &meshlet, const std::vector<glm::vec3> &positions,
+                     const std::vector<GLuint> &vertices,
+                     const std::vector<glm::vec3> &normals)
+  {
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    glm::vec3 min(std::numeric_limits<float>::max());
+    for (const auto index : vertices)
+    {
+      max = glm::max(max, positions[index]);
+      min = glm::min(min, positions[index]);
+    }
+    meshlet.center = (min + max) / 2.0f;
+    meshlet.radius = 0.0f;
+    for (const auto index : vertices)
+      meshlet.radius = std::max(meshlet.radius,
+                                glm::length(positions[index] - meshlet.center));
+
+    // Average the triangle normals and take the widest deviation from it
+    glm::vec3 axis{0.0f};
+    for (const auto &normal : normals)
+      axis += normal;
+    const auto axisLength{glm::length(axis)};
+    meshlet.coneAxis = glm::vec3{0.0f, 0.0f, 1.0f};
+    meshlet.coneCutoff = 1.0f; // Never backfacing
+    if (normals.empty() || !(axisLength > 0.0f))
+      return;
+
+    meshlet.coneAxis = axis / axisLength;
+    auto minDot{1.0f};
+    for (const auto &normal : normals)
+      minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normal));
+    if (minDot > 0.0f)
+      meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  }
+} // namespace
+
+void IndexLayout::build(const std::vector<glm::vec3> &positions,
+                        const std::vector<GLuint> &indices,
+                        const std::vector<IndexRange> &ranges)
+{
+  m_ranges = ranges;
+  m_meshlets.clear();
+  m_meshletVertices.clear();
+  m_firstMeshlet.clear();
+  m_counts.clear();
+  m_offsets.clear();
+  m_baseVertices.clear();
+
+  if (positions.size() <= maxShortVertices)
+  {
+    m_type = GL_UNSIGNED_SHORT;
+    m_data =
+        toBytes(std::vector<std::uint16_t>(indices.begin(), indices.end()));
+    return;
+  }
+
+  buildMeshlets(positions, indices);
+
+  // Indices relative to the first vertex of their meshlet
+  std::vector<GLuint> localIndices(indices.size());
+  std::vector<GLuint> newIndex(positions.size());
+  for (const auto &meshlet : m_meshlets)
+  {
+    for (const auto i : iter::range(meshlet.vertexCount))
+      newIndex[m_meshletVertices[meshlet.vertexOffset + i]] = i;
+    const auto end{meshlet.indexOffset + meshlet.indexCount};
+    for (auto i{meshlet.indexOffset}; i < end; ++i)
+      localIndices[i] = newIndex[indices[i]];
+  }
+
+#if defined(__EMSCRIPTEN__)
+  // WebGL 2 has no base vertex draws, so rebase the indices instead
+  m_type = GL_UNSIGNED_INT;
+  for (const auto &meshlet : m_meshlets)
+  {
+    const auto end{meshlet.indexOffset + meshlet.indexCount};
+    for (auto i{meshlet.indexOffset}; i < end; ++i)
+      localIndices[i] += meshlet.vertexOffset;
+  }
+  m_data = toBytes(localIndices);
+#else
+  m_type = GL_UNSIGNED_SHORT;
+  m_data = toBytes(
+      std::vector<std::uint16_t>(localIndices.begin(), localIndices.end()));
+  for (const auto &meshlet : m_meshlets)
+  {
+    m_counts.push_back(static_cast<GLsizei>(meshlet.indexCount));
+    m_offsets.push_back(reinterpret_cast<const void *>(
+        meshlet.indexOffset * sizeof(std::uint16_t)));
+    m_baseVertices.push_back(static_cast<GLint>(meshlet.vertexOffset));
+  }
+#endif
+}
+
+void IndexLayout::buildMeshlets(const std::vector<glm::vec3> &positions,
+                                const std::vector<GLuint> &indices)
+{
+  constexpr int notInMeshlet{-1};
+  std::vector<int> localIndex(positions.size(), notInMeshlet);
+
+  Meshlet meshlet;
+  std::vector<GLuint> vertices;
+  std::vector<glm::vec3> normals;
+
+  const auto flush{[&]
+                   {
+                     if (meshlet.indexCount == 0)
+                       return;
+                     meshlet.vertexOffset =
+                         static_cast<GLuint>(m_meshletVertices.size());
+                     meshlet.vertexCount = static_cast<GLuint>(vertices.size());
+                     computeBounds(meshlet, positions, vertices, normals);
+                     m_meshlets.push_back(meshlet);
+                     m_meshletVertices.insert(m_meshletVertices.end(),
+                                              vertices.begin(), vertices.end());
+                     for (const auto index : vertices)
+                       localIndex[index] = notInMeshlet;
+                     vertices.clear();
+                     normals.clear();
+                     meshlet = Meshlet{};
+                   }};
+
+  for (const auto &range : m_ranges)
+  {
+    m_firstMeshlet.push_back(m_meshlets.size());
+    for (auto i{range.first}; i + 3 <= range.first + range.count; i += 3)
+    {
+      const auto *triangle{indices.data() + i};
+
+      std::size_t newVertices{};
+      for (const auto j : {0, 1, 2})
+      {
+        const auto isRepeated{(j > 0 && triangle[j] == triangle[0]) ||
+                              (j > 1 && triangle[j] == triangle[1])};
+        if (localIndex[triangle[j]] == notInMeshlet && !isRepeated)
+          ++newVertices;
+      }
+      if (vertices.size() + newVertices > maxMeshletVertices ||
+          meshlet.indexCount / 3 + 1 > maxMeshletTriangles)
+        flush();
+
+      if (meshlet.indexCount == 0)
+        meshlet.indexOffset = static_cast<GLuint>(i);
+      meshlet.indexCount += 3;
+
+      for (const auto j : {0, 1, 2})
+      {
+        if (localIndex[triangle[j]] == notInMeshlet)
+        {
+          localIndex[triangle[j]] = static_cast<int>(vertices.size());
+          vertices.push_back(triangle[j]);
+        }
+      }
+
+      const auto &a{positions[triangle[0]]};
+      const auto &b{positions[triangle[1]]};
+      const auto &c{positions[triangle[2]]};
+      const auto normal{glm::cross(b - a, c - a)};
+      const auto length{glm::length(normal)};
+      if (length > 0.0f)
+        normals.push_back(normal / length);
+    }
+    flush();
+  }
+  m_firstMeshlet.push_back(m_meshlets.size());
+}
+
+void IndexLayout::draw(std::size_t range, int maxTriangles) const
+{
+  const auto &indexRange{m_ranges.at(range)};
+  auto count{indexRange.count};
+  if (maxTriangles >= 0)
+    count = std::min(count, static_cast<std::size_t>(maxTriangles) * 3);
+
+  // abcg only wraps the OpenGL ES 3.0 functions, so the desktop-only
+  // multi-draw and base-vertex calls in this file are made directly
+#if !defined(__EMSCRIPTEN__)
+  if (!m_meshlets.empty())
+  {
+    // Whole meshlets in a single call, then what is left of the last one
+    const auto first{m_firstMeshlet.at(range)};
+    const auto last{m_firstMeshlet.at(range + 1)};
+    const auto end{indexRange.first + count};
+    auto whole{first};
+    while (whole < last &&
+           m_meshlets[whole].indexOffset + m_meshlets[whole].indexCount <= end)
+      ++whole;
+
+    if (whole > first)
+      glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_counts.data() + first,
+                                    m_type, m_offsets.data() + first,
+                                    static_cast<GLsizei>(whole - first),
+                                    m_baseVertices.data() + first);
+    if (whole < last && m_meshlets[whole].indexOffset < end)
+      glDrawElementsBaseVertex(
+          GL_TRIANGLES,
+          static_cast<GLsizei>(end - m_meshlets[whole].indexOffset), m_type,
+          m_offsets[whole], m_baseVertices[whole]);
+    return;
+  }
+#endif
+
+  const auto indexSize{m_type == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t)
+                                                   : sizeof(GLuint)};
+  abcg::glDrawElements(
+      GL_TRIANGLES, static_cast<GLsizei>(count), m_type,
+      reinterpret_cast<void *>(indexRange.first * indexSize));
+}
+
+void IndexLayout::draw(const std::vector<std::size_t> &ranges) const
+{
+  m_drawCounts.clear();
+  m_drawOffsets.clear();
+  m_drawBaseVertices.clear();
+
+#if !defined(__EMSCRIPTEN__)
+  if (!m_meshlets.empty())
+  {
+    for (const auto range : ranges)
+    {
+      const auto first{m_firstMeshlet.at(range)};
+      const auto last{m_firstMeshlet.at(range + 1)};
+      m_drawCounts.insert(m_drawCounts.end(), m_counts.begin() + first,
+                          m_counts.begin() + last);
+      m_drawOffsets.insert(m_drawOffsets.end(), m_offsets.begin() + first,
+                           m_offsets.begin() + last);
+      m_drawBaseVertices.insert(m_drawBaseVertices.end(),
+                                m_baseVertices.begin() + first,
+                                m_baseVertices.begin() + last);
+    }
+    if (!m_drawCounts.empty())
+      glMultiDrawElementsBaseVertex(
+          GL_TRIANGLES, m_drawCounts.data(), m_type, m_drawOffsets.data(),
+          static_cast<GLsizei>(m_drawCounts.size()),
+          m_drawBaseVertices.data());
+    return;
+  }
+#endif
+
+  // Ranges that follow each other in the buffer become a single draw
+  const auto indexSize{m_type == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t)
+                                                   : sizeof(GLuint)};
+  std::size_t spanEnd{};
+  for (const auto range : ranges)
+  {
+    const auto &indexRange{m_ranges.at(range)};
+    if (!m_drawCounts.empty() && indexRange.first == spanEnd)
+    {
+      m_drawCounts.back() += static_cast<GLsizei>(indexRange.count);
+    }
+    else
+    {
+      m_drawCounts.push_back(static_cast<GLsizei>(indexRange.count));
+      m_drawOffsets.push_back(
+          reinterpret_cast<const void *>(indexRange.first * indexSize));
+    }
+    spanEnd = indexRange.first + indexRange.count;
+  }
+
+#if !defined(__EMSCRIPTEN__)
+  if (!m_drawCounts.empty())
+    glMultiDrawElements(GL_TRIANGLES, m_drawCounts.data(), m_type,
+                        m_drawOffsets.data(),
+                        static_cast<GLsizei>(m_drawCounts.size()));
+#else
+  for (const auto i : iter::range(m_drawCounts.size()))
+    abcg::glDrawElements(GL_TRIANGLES, m_drawCounts[i], m_type,
+                         m_drawOffsets[i]);
+#endif
+}
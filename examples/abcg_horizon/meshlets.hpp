@@ -0,0 +1,119 @@
+#ifndef MESHLETS_HPP_
+#define MESHLETS_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "abcg.hpp"
+#include "vertexcache.hpp"
+
+// Small cluster of triangles with its own run of vertices, so its indices
+// are local and fit in 16 bits
+struct Meshlet
+{
+  GLuint vertexOffset{};
+  GLuint vertexCount{};
+  GLuint indexOffset{};
+  GLuint indexCount{};
+
+  // Bounding sphere
+  glm::vec3 center{};
+  float radius{};
+
+  // Normal cone: every triangle faces away from any viewpoint for which
+  // isBackfacing() holds
+  glm::vec3 coneAxis{};
+  float coneCutoff{1.0f};
+
+  [[nodiscard]] bool isBackfacing(const glm::vec3 &cameraPosition) const
+  {
+    const auto direction{center - cameraPosition};
+    return glm::dot(direction, coneAxis) >=
+           coneCutoff * glm::length(direction) + radius;
+  }
+};
+
+// Index buffer of a mesh in the narrowest type that can address it. Meshes
+// of up to 65536 vertices use 16-bit indices as they are. Larger meshes are
+// split into meshlets whose vertices are laid out contiguously, so that
+// local 16-bit indices plus a base vertex address them. Meshlets never cross
+// an index range and keep the triangle order, so a range keeps its offset
+// and can still be drawn as a whole.
+class IndexLayout
+{
+public:
+  static constexpr std::size_t maxMeshletVertices{64};
+  static constexpr std::size_t maxMeshletTriangles{124};
+
+  // V must have a glm::vec3 position member
+  template <typename V>
+  void build(const std::vector<V> &vertices,
+             const std::vector<GLuint> &indices,
+             const std::vector<IndexRange> &ranges)
+  {
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const auto &vertex : vertices)
+      positions.push_back(vertex.position);
+    build(positions, indices, ranges);
+  }
+
+  void build(const std::vector<glm::vec3> &positions,
+             const std::vector<GLuint> &indices,
+             const std::vector<IndexRange> &ranges);
+
+  // Vertices in the order expected by the indices: the same array unless
+  // the mesh was split into meshlets
+  template <typename V>
+  [[nodiscard]] std::vector<V>
+  layoutVertices(const std::vector<V> &vertices) const
+  {
+    if (m_meshlets.empty())
+      return vertices;
+    std::vector<V> reordered;
+    reordered.reserve(m_meshletVertices.size());
+    for (const auto index : m_meshletVertices)
+      reordered.push_back(vertices[index]);
+    return reordered;
+  }
+
+  // Draws range (or only its first maxTriangles triangles) with the VAO
+  // already bound
+  void draw(std::size_t range, int maxTriangles = -1) const;
+
+  // Draws several whole ranges with a single multi-draw call (one call per
+  // run of adjacent ranges on WebGL 2, which has no multi-draw)
+  void draw(const std::vector<std::size_t> &ranges) const;
+
+  [[nodiscard]] std::size_t rangeCount() const { return m_ranges.size(); }
+  [[nodiscard]] const std::vector<std::byte> &data() const { return m_data; }
+  [[nodiscard]] GLenum type() const { return m_type; }
+  [[nodiscard]] const std::vector<Meshlet> &meshlets() const
+  {
+    return m_meshlets;
+  }
+
+private:
+  std::vector<std::byte> m_data;
+  GLenum m_type{GL_UNSIGNED_INT};
+  std::vector<IndexRange> m_ranges;
+
+  std::vector<Meshlet> m_meshlets;
+  std::vector<GLuint> m_meshletVertices; // Source vertex of each new vertex
+  std::vector<std::size_t> m_firstMeshlet; // Per range, plus one at the end
+
+  // Arguments of glMultiDrawElementsBaseVertex, one entry per meshlet
+  std::vector<GLsizei> m_counts;
+  std::vector<const void *> m_offsets;
+  std::vector<GLint> m_baseVertices;
+
+  // Arguments of the multi-range draw, rebuilt on every call
+  mutable std::vector<GLsizei> m_drawCounts;
+  mutable std::vector<const void *> m_drawOffsets;
+  mutable std::vector<GLint> m_drawBaseVertices;
+
+  void buildMeshlets(const std::vector<glm::vec3> &positions,
+                     const std::vector<GLuint> &indices);
+};
+
+#endif
@@ -0,0 +1,637 @@
+#include "objparser.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+
+#include "parallel.hpp"
+
+namespace
+{
+  // Files smaller than this per worker are not worth splitting
+  constexpr std::size_t minChunkSize{256 * 1024};
+
+  // Face corners whose references are relative (negative) are resolved
+  // against the global counts once every chunk has been parsed
+  struct RelativeIndex
+  {
+    std::size_t corner;
+    bool vertex;
+    bool normal;
+    bool texCoord;
+  };
+
+  // An o, g or usemtl record, or a commented-out "# usemtl" line, at the
+  // number of triangles before it
+  struct SubmeshMarker
+  {
+    enum class Kind
+    {
+      Name,
+      Material,
+      Split // Starts a submesh and changes neither name nor material
+    };
+
+    std::size_t triangle;
+    Kind kind;
+    std::string value;
+  };
+
+  struct Chunk
+  {
+    const char *begin{};
+    const char *end{};
+
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texCoords;
+    std::vector<ObjIndex> corners;
+    std::vector<unsigned> faceSizes;
+    std::vector<RelativeIndex> relativeIndices;
+    std::vector<std::string> materialLibs;
+    std::vector<SubmeshMarker> markers;
+
+    // Prefix sums over the previous chunks
+    std::size_t firstPosition{};
+    std::size_t firstNormal{};
+    std::size_t firstTexCoord{};
+    std::size_t firstTriangle{};
+    std::size_t numTriangles{};
+
+    std::string error;
+  };
+
+  bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+  void skipBlanks(const char *&p, const char *end)
+  {
+    while (p < end && isBlank(*p))
+      ++p;
+  }
+
+  std::string_view nextToken(const char *&p, const char *end)
+  {
+    skipBlanks(p, end);
+    const auto *first{p};
+    while (p < end && !isBlank(*p))
+      ++p;
+    return {first, static_cast<std::size_t>(p - first)};
+  }
+
+  std::string_view restOfLine(const char *p, const char *end)
+  {
+    skipBlanks(p, end);
+    while (end > p && isBlank(*(end - 1)))
+      --end;
+    return {p, static_cast<std::size_t>(end - p)};
+  }
+
+  // Parses as double and rounds to float, like tinyobjloader does
+  bool parseFloat(const char *&p, const char *end, float &value)
+  {
+    skipBlanks(p, end);
+    if (p < end && *p == '+')
+      ++p;
+    double result{};
+    const auto [last, error]{std::from_chars(p, end, result)};
+    if (error != std::errc{})
+      return false;
+    p = last;
+    value = static_cast<float>(result);
+    return true;
+  }
+
+  void parseFloats(const char *p, const char *end, std::vector<float> &values,
+                   int count)
+  {
+    for (int i{}; i < count; ++i)
+    {
+      float value{};
+      parseFloat(p, end, value);
+      values.push_back(value);
+    }
+  }
+
+  // Converts a one-based (or negative, relative) OBJ reference
+  bool parseReference(std::string_view token, std::size_t count, int &index,
+                      bool &relative)
+  {
+    int value{};
+    const auto [last, error]{
+        std::from_chars(token.data(), token.data() + token.size(), value)};
+    if (error != std::errc{} || last != token.data() + token.size() ||
+        value == 0)
+      return false;
+    relative = value < 0;
+    index = relative ? static_cast<int>(count) + value : value - 1;
+    return true;
+  }
+
+  bool parseCorner(std::string_view token, Chunk &chunk)
+  {
+    std::string_view fields[3];
+    for (auto &field : fields)
+    {
+      const auto slash{token.find('/')};
+      field = token.substr(0, slash);
+      if (slash == std::string_view::npos)
+        break;
+      token.remove_prefix(slash + 1);
+    }
+
+    ObjIndex corner;
+    RelativeIndex relative{chunk.corners.size(), false, false, false};
+    if (!parseReference(fields[0], chunk.positions.size() / 3, corner.vertex,
+                        relative.vertex))
+      return false;
+    if (!fields[1].empty() &&
+        !parseReference(fields[1], chunk.texCoords.size() / 2,
+                        corner.texCoord, relative.texCoord))
+      return false;
+    if (!fields[2].empty() &&
+        !parseReference(fields[2], chunk.normals.size() / 3, corner.normal,
+                        relative.normal))
+      return false;
+
+    if (relative.vertex || relative.normal || relative.texCoord)
+      chunk.relativeIndices.push_back(relative);
+    chunk.corners.push_back(corner);
+    return true;
+  }
+
+  void parseChunk(Chunk &chunk)
+  {
+    const auto *p{chunk.begin};
+    while (p < chunk.end && chunk.error.empty())
+    {
+      const auto *lineEnd{std::find(p, chunk.end, '\n')};
+      const auto *cursor{p};
+      const auto keyword{nextToken(cursor, lineEnd)};
+
+      if (keyword == "v")
+      {
+        parseFloats(cursor, lineEnd, chunk.positions, 3);
+      }
+      else if (keyword == "vn")
+      {
+        parseFloats(cursor, lineEnd, chunk.normals, 3);
+      }
+      else if (keyword == "vt")
+      {
+        parseFloats(cursor, lineEnd, chunk.texCoords, 2);
+      }
+      else if (keyword == "f")
+      {
+        unsigned size{};
+        for (auto token{nextToken(cursor, lineEnd)}; !token.empty();
+             token = nextToken(cursor, lineEnd))
+        {
+          if (!parseCorner(token, chunk))
+          {
+            chunk.error = fmt::format("invalid face \"{}\"",
+                                      restOfLine(p, lineEnd));
+            break;
+          }
+          ++size;
+        }
+        if (size >= 3)
+        {
+          chunk.faceSizes.push_back(size);
+          chunk.numTriangles += size - 2;
+        }
+        else
+        {
+          // Skip degenerate faces, with the relative indices of their corners
+          chunk.corners.resize(chunk.corners.size() - size);
+          while (!chunk.relativeIndices.empty() &&
+                 chunk.relativeIndices.back().corner >= chunk.corners.size())
+            chunk.relativeIndices.pop_back();
+        }
+      }
+      else if (keyword == "mtllib")
+      {
+        chunk.materialLibs.emplace_back(restOfLine(cursor, lineEnd));
+      }
+      else if (keyword == "o" || keyword == "g" || keyword == "usemtl")
+      {
+        chunk.markers.push_back({chunk.numTriangles,
+                                 keyword == "usemtl"
+                                     ? SubmeshMarker::Kind::Material
+                                     : SubmeshMarker::Kind::Name,
+                                 std::string{restOfLine(cursor, lineEnd)}});
+      }
+      else if (keyword == "#" && nextToken(cursor, lineEnd) == "usemtl")
+      {
+        // Exporters that drop a material comment its usemtl out; the parts
+        // of testarossa.obj are delimited by these lines as well
+        chunk.markers.push_back({chunk.numTriangles,
+                                 SubmeshMarker::Kind::Split, {}});
+      }
+
+      p = lineEnd + 1;
+    }
+  }
+
+  std::string parseTexName(const char *p, const char *end)
+  {
+    // Texture options (e.g. -bm 1.0) precede the file name
+    auto name{restOfLine(p, end)};
+    if (!name.empty() && name.front() == '-')
+      name = name.substr(name.find_last_of(" \t") + 1);
+    return std::string{name};
+  }
+
+  void parseMaterialLib(const std::string &path,
+                        std::vector<ObjMaterial> &materials)
+  {
+    std::ifstream stream{path};
+    if (!stream)
+    {
+      fmt::print("Warning: Material file [ {} ] not found.\n", path);
+      return;
+    }
+
+    std::string line;
+    while (std::getline(stream, line))
+    {
+      const auto *p{line.data()};
+      const auto *end{line.data() + line.size()};
+      const auto keyword{nextToken(p, end)};
+
+      if (keyword == "newmtl")
+      {
+        auto &material{materials.emplace_back()};
+        material.name = restOfLine(p, end);
+        continue;
+      }
+      if (materials.empty())
+        continue;
+
+      auto &material{materials.back()};
+      const auto parseColor{[&](glm::vec3 &color)
+                            {
+                              parseFloat(p, end, color.r);
+                              parseFloat(p, end, color.g);
+                              parseFloat(p, end, color.b);
+                            }};
+      if (keyword == "Ka")
+        parseColor(material.ambient);
+      else if (keyword == "Kd")
+        parseColor(material.diffuse);
+      else if (keyword == "Ks")
+        parseColor(material.specular);
+      else if (keyword == "Ns")
+        parseFloat(p, end, material.shininess);
+      else if (keyword == "map_Kd")
+        material.diffuseTexName = parseTexName(p, end);
+      else if (keyword == "norm")
+        material.normalTexName = parseTexName(p, end);
+      else if (keyword == "map_Bump" || keyword == "map_bump" ||
+               keyword == "bump")
+        material.bumpTexName = parseTexName(p, end);
+    }
+  }
+
+  void triangulateChunk(const Chunk &chunk, ObjData &data)
+  {
+    auto *triangle{data.indices.data() + 3 * chunk.firstTriangle};
+    const auto *corner{chunk.corners.data()};
+    const auto &positions{data.positions};
+
+    for (const auto size : chunk.faceSizes)
+    {
+      if (size == 4)
+      {
+        // Split quads along the shortest diagonal
+        const auto squaredDistance{[&](int a, int b)
+                                   {
+                                     const auto *pa{&positions[3 * a]};
+                                     const auto *pb{&positions[3 * b]};
+                                     const float dx{pb[0] - pa[0]};
+                                     const float dy{pb[1] - pa[1]};
+                                     const float dz{pb[2] - pa[2]};
+                                     return dx * dx + dy * dy + dz * dz;
+                                   }};
+        const auto d02{squaredDistance(corner[0].vertex, corner[2].vertex)};
+        const auto d13{squaredDistance(corner[1].vertex, corner[3].vertex)};
+        const auto order{d02 < d13 ? std::array{0, 1, 2, 0, 2, 3}
+                                   : std::array{0, 1, 3, 1, 2, 3}};
+        for (const auto i : order)
+          *triangle++ = corner[i];
+      }
+      else
+      {
+        // Fan triangulation
+        for (unsigned i{2}; i < size; ++i)
+        {
+          *triangle++ = corner[0];
+          *triangle++ = corner[i - 1];
+          *triangle++ = corner[i];
+        }
+      }
+      corner += size;
+    }
+  }
+
+  // Continues the submeshes of data with the markers of the chunk that
+  // follows them. The last submesh is left open, possibly empty.
+  void appendSubmeshes(const Chunk &chunk, ObjData &data)
+  {
+    auto &submeshes{data.submeshes};
+    if (submeshes.empty())
+      submeshes.emplace_back();
+
+    for (const auto &marker : chunk.markers)
+    {
+      const auto firstIndex{3 * (chunk.firstTriangle + marker.triangle)};
+      if (firstIndex > submeshes.back().firstIndex)
+      {
+        submeshes.back().indexCount = firstIndex - submeshes.back().firstIndex;
+        // Only the names carry over; the bounds may have grown already
+        ObjSubmesh next;
+        next.name = submeshes.back().name;
+        next.material = submeshes.back().material;
+        next.firstIndex = firstIndex;
+        submeshes.push_back(std::move(next));
+      }
+      if (marker.kind == SubmeshMarker::Kind::Material)
+        submeshes.back().material = marker.value;
+      else if (marker.kind == SubmeshMarker::Kind::Name)
+        submeshes.back().name = marker.value;
+    }
+
+    submeshes.back().indexCount =
+        3 * (chunk.firstTriangle + chunk.numTriangles) -
+        submeshes.back().firstIndex;
+  }
+
+  // Grows the bounds of the submeshes from the indices past firstIndex
+  void growSubmeshBounds(ObjData &data, std::size_t firstIndex)
+  {
+    for (auto &submesh : data.submeshes)
+    {
+      const auto end{submesh.firstIndex + submesh.indexCount};
+      for (auto i{std::max(firstIndex, submesh.firstIndex)}; i < end; ++i)
+      {
+        const auto *position{&data.positions[3 * data.indices[i].vertex]};
+        const glm::vec3 point{position[0], position[1], position[2]};
+        submesh.boundsMin = glm::min(submesh.boundsMin, point);
+        submesh.boundsMax = glm::max(submesh.boundsMax, point);
+      }
+    }
+  }
+
+  void removeEmptySubmeshes(ObjData &data)
+  {
+    auto &submeshes{data.submeshes};
+    submeshes.erase(std::remove_if(submeshes.begin(), submeshes.end(),
+                                   [](const ObjSubmesh &submesh)
+                                   { return submesh.indexCount == 0; }),
+                    submeshes.end());
+  }
+} // namespace
+
+ObjData parseObj(std::string_view path, std::size_t numThreads)
+{
+  std::vector<char> file;
+  {
+    std::ifstream stream{std::string{path}, std::ios::binary | std::ios::ate};
+    if (!stream)
+    {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to load model {} (cannot open file)", path))};
+    }
+    file.resize(static_cast<std::size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(file.data(), static_cast<std::streamsize>(file.size()));
+  }
+
+  const auto numChunks{std::clamp<std::size_t>(
+      file.size() / minChunkSize, 1, resolveThreadCount(numThreads))};
+
+  // Split the file at line boundaries
+  std::vector<Chunk> chunks(numChunks);
+  const auto *fileEnd{file.data() + file.size()};
+  for (std::size_t i{}; i < numChunks; ++i)
+  {
+    auto &chunk{chunks.at(i)};
+    chunk.begin = (i == 0) ? file.data() : chunks.at(i - 1).end;
+    chunk.end = (i + 1 == numChunks)
+                    ? fileEnd
+                    : file.data() + file.size() * (i + 1) / numChunks;
+    chunk.end = std::max(chunk.end, chunk.begin);
+    while (chunk.end < fileEnd && *(chunk.end - 1) != '\n')
+      ++chunk.end;
+  }
+
+  runChunks(numChunks, [&chunks](std::size_t i) { parseChunk(chunks.at(i)); });
+
+  for (const auto &chunk : chunks)
+  {
+    if (!chunk.error.empty())
+    {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to load model {} ({})", path, chunk.error))};
+    }
+  }
+
+  // Prefix sums of the per-chunk attribute and triangle counts
+  ObjData data;
+  std::size_t numPositions{};
+  std::size_t numNormals{};
+  std::size_t numTexCoords{};
+  std::size_t numTriangles{};
+  for (auto &chunk : chunks)
+  {
+    chunk.firstPosition = numPositions;
+    chunk.firstNormal = numNormals;
+    chunk.firstTexCoord = numTexCoords;
+    chunk.firstTriangle = numTriangles;
+    numPositions += chunk.positions.size() / 3;
+    numNormals += chunk.normals.size() / 3;
+    numTexCoords += chunk.texCoords.size() / 2;
+    numTriangles += chunk.numTriangles;
+  }
+  data.positions.resize(numPositions * 3);
+  data.normals.resize(numNormals * 3);
+  data.texCoords.resize(numTexCoords * 2);
+  data.indices.resize(numTriangles * 3);
+
+  // Merge attributes and resolve relative references
+  runChunks(numChunks,
+            [&](std::size_t i)
+            {
+              auto &chunk{chunks.at(i)};
+              std::copy(chunk.positions.begin(), chunk.positions.end(),
+                        data.positions.begin() + 3 * chunk.firstPosition);
+              std::copy(chunk.normals.begin(), chunk.normals.end(),
+                        data.normals.begin() + 3 * chunk.firstNormal);
+              std::copy(chunk.texCoords.begin(), chunk.texCoords.end(),
+                        data.texCoords.begin() + 2 * chunk.firstTexCoord);
+
+              for (const auto &relative : chunk.relativeIndices)
+              {
+                auto &corner{chunk.corners.at(relative.corner)};
+                if (relative.vertex)
+                  corner.vertex += static_cast<int>(chunk.firstPosition);
+                if (relative.normal)
+                  corner.normal += static_cast<int>(chunk.firstNormal);
+                if (relative.texCoord)
+                  corner.texCoord += static_cast<int>(chunk.firstTexCoord);
+              }
+
+              for (const auto &corner : chunk.corners)
+              {
+                if (corner.vertex < 0 ||
+                    static_cast<std::size_t>(corner.vertex) >= numPositions ||
+                    static_cast<std::size_t>(corner.normal + 1) >
+                        numNormals ||
+                    static_cast<std::size_t>(corner.texCoord + 1) >
+                        numTexCoords)
+                {
+                  chunk.error = "face refers to a missing vertex attribute";
+                  return;
+                }
+              }
+            });
+
+  for (const auto &chunk : chunks)
+  {
+    if (!chunk.error.empty())
+    {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to load model {} ({})", path, chunk.error))};
+    }
+  }
+
+  runChunks(numChunks, [&](std::size_t i)
+            { triangulateChunk(chunks.at(i), data); });
+
+  for (const auto &chunk : chunks)
+    appendSubmeshes(chunk, data);
+  removeEmptySubmeshes(data);
+  growSubmeshBounds(data, 0);
+
+  // Material libraries are small; read them on this thread
+  const auto basePath{std::filesystem::path{path}.parent_path()};
+  for (const auto &chunk : chunks)
+  {
+    for (const auto &materialLib : chunk.materialLibs)
+    {
+      parseMaterialLib((basePath / materialLib).string(), data.materials);
+    }
+  }
+
+  for (auto &submesh : data.submeshes)
+  {
+    const auto material{std::find_if(
+        data.materials.begin(), data.materials.end(),
+        [&submesh](const ObjMaterial &candidate)
+        { return candidate.name == submesh.material; })};
+    if (!submesh.material.empty() && material != data.materials.end())
+      submesh.materialIndex =
+          static_cast<int>(material - data.materials.begin());
+  }
+
+  return data;
+}
+
+ObjStreamReader::ObjStreamReader(std::string_view path, std::size_t blockSize)
+    : m_path{path},
+      m_stream{m_path, std::ios::binary | std::ios::ate},
+      m_blockSize{std::max<std::size_t>(blockSize, 1)}
+{
+  if (!m_stream)
+  {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to load model {} (cannot open file)", path))};
+  }
+  m_fileSize = static_cast<std::size_t>(m_stream.tellg());
+  m_stream.seekg(0);
+}
+
+bool ObjStreamReader::read(ObjData &data)
+{
+  if (m_bytesRead == m_fileSize && m_buffer.empty())
+    return false;
+
+  // Append the next block to the cut line left over by the previous one
+  const auto leftover{m_buffer.size()};
+  const auto blockSize{std::min(m_blockSize, m_fileSize - m_bytesRead)};
+  m_buffer.resize(leftover + blockSize);
+  m_stream.read(m_buffer.data() + leftover,
+                static_cast<std::streamsize>(blockSize));
+  m_bytesRead += blockSize;
+
+  // Parse up to the last complete line
+  Chunk chunk;
+  chunk.begin = m_buffer.data();
+  chunk.end = m_buffer.data() + m_buffer.size();
+  if (m_bytesRead < m_fileSize)
+  {
+    while (chunk.end > chunk.begin && *(chunk.end - 1) != '\n')
+      --chunk.end;
+  }
+  parseChunk(chunk);
+  if (!chunk.error.empty())
+  {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to load model {} ({})", m_path, chunk.error))};
+  }
+
+  chunk.firstPosition = data.positions.size() / 3;
+  chunk.firstNormal = data.normals.size() / 3;
+  chunk.firstTexCoord = data.texCoords.size() / 2;
+  chunk.firstTriangle = data.indices.size() / 3;
+  data.positions.insert(data.positions.end(), chunk.positions.begin(),
+                        chunk.positions.end());
+  data.normals.insert(data.normals.end(), chunk.normals.begin(),
+                      chunk.normals.end());
+  data.texCoords.insert(data.texCoords.end(), chunk.texCoords.begin(),
+                        chunk.texCoords.end());
+
+  for (const auto &relative : chunk.relativeIndices)
+  {
+    auto &corner{chunk.corners.at(relative.corner)};
+    if (relative.vertex)
+      corner.vertex += static_cast<int>(chunk.firstPosition);
+    if (relative.normal)
+      corner.normal += static_cast<int>(chunk.firstNormal);
+    if (relative.texCoord)
+      corner.texCoord += static_cast<int>(chunk.firstTexCoord);
+  }
+
+  const auto numPositions{data.positions.size() / 3};
+  const auto numNormals{data.normals.size() / 3};
+  const auto numTexCoords{data.texCoords.size() / 2};
+  for (const auto &corner : chunk.corners)
+  {
+    if (corner.vertex < 0 ||
+        static_cast<std::size_t>(corner.vertex) >= numPositions ||
+        static_cast<std::size_t>(corner.normal + 1) > numNormals ||
+        static_cast<std::size_t>(corner.texCoord + 1) > numTexCoords)
+    {
+      throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+          "Failed to load model {} (face refers to a missing vertex "
+          "attribute)",
+          m_path))};
+    }
+  }
+
+  const auto firstIndex{data.indices.size()};
+  data.indices.resize(firstIndex + chunk.numTriangles * 3);
+  triangulateChunk(chunk, data);
+  appendSubmeshes(chunk, data);
+  growSubmeshBounds(data, firstIndex);
+
+  // Keep the cut line for the next block
+  m_buffer.erase(m_buffer.begin(),
+                 m_buffer.begin() + (chunk.end - chunk.begin));
+  if (m_bytesRead == m_fileSize && m_buffer.empty())
+    removeEmptySubmeshes(data);
+  return true;
+}
@@ -0,0 +1,93 @@
+#ifndef OBJPARSER_HPP_
+#define OBJPARSER_HPP_
+
+#include <cstddef>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "abcg.hpp"
+
+// Zero-based references of a face corner; -1 when the attribute is absent
+struct ObjIndex
+{
+  int vertex{-1};
+  int normal{-1};
+  int texCoord{-1};
+};
+
+struct ObjMaterial
+{
+  std::string name;
+  glm::vec3 ambient{};
+  glm::vec3 diffuse{};
+  glm::vec3 specular{};
+  float shininess{1.0f};
+  std::string diffuseTexName;
+  std::string normalTexName;
+  std::string bumpTexName;
+};
+
+// Run of triangles that share an object or group name and a material. A new
+// submesh starts at every o, g or usemtl record, or "# usemtl" comment line,
+// that follows some faces.
+struct ObjSubmesh
+{
+  std::string name;     // Of the last o or g record; empty before any
+  std::string material; // Of the last usemtl record; empty before any
+  int materialIndex{-1}; // Into ObjData::materials; -1 when not found
+  std::size_t firstIndex{}; // Into ObjData::indices
+  std::size_t indexCount{};
+  glm::vec3 boundsMin{std::numeric_limits<float>::max()};
+  glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+};
+
+struct ObjData
+{
+  std::vector<float> positions; // x, y, z
+  std::vector<float> normals;   // x, y, z
+  std::vector<float> texCoords; // u, v
+  std::vector<ObjIndex> indices; // Three per triangle, in file order
+  std::vector<ObjMaterial> materials;
+  std::vector<ObjSubmesh> submeshes; // Cover indices in order, none empty
+};
+
+// Parses a Wavefront OBJ file (and its material libraries) by splitting the
+// file at line boundaries across numThreads workers; 0 picks the number of
+// hardware threads. Polygons are triangulated the same way as tinyobjloader
+// so the result can replace tinyobj::ObjReader in the loaders.
+// Throws abcg::Exception on failure.
+[[nodiscard]] ObjData parseObj(std::string_view path,
+                               std::size_t numThreads = 0);
+
+// Parses an OBJ file one block at a time, so a viewer can draw the triangles
+// read so far while the rest of the file is still on its way. Each read()
+// appends the attributes and triangles of about blockSize more bytes to
+// data. Faces may only refer to attributes defined before them, which is how
+// exporters write them. Material libraries are not read, and the last
+// submesh may be empty until the whole file has been read.
+class ObjStreamReader
+{
+public:
+  explicit ObjStreamReader(std::string_view path,
+                           std::size_t blockSize = 4 * 1024 * 1024);
+
+  // Returns false once the whole file has been read. Throws abcg::Exception
+  // on failure.
+  bool read(ObjData &data);
+
+  [[nodiscard]] std::size_t bytesRead() const { return m_bytesRead; }
+  [[nodiscard]] std::size_t fileSize() const { return m_fileSize; }
+
+private:
+  std::string m_path;
+  std::ifstream m_stream;
+  std::size_t m_blockSize{};
+  std::size_t m_fileSize{};
+  std::size_t m_bytesRead{};
+  std::vector<char> m_buffer; // Starts with the line cut by the last block
+};
+
+#endif
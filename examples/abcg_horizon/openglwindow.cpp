@@ -4,8 +4,12 @@
 #include <imgui.h>
 
 #include <cppitertools/itertools.hpp>
+#include <cstdlib>
 #include <glm/gtc/matrix_inverse.hpp>
 
+#include "glstate.hpp"
+#include "samplers.hpp"
+
 void OpenGLWindow::handleEvent(SDL_Event &ev)
 {
   if (ev.type == SDL_KEYDOWN)
@@ -37,41 +41,170 @@ void OpenGLWindow::initializeGL()
   glClearColor(0, 0, 0, 1);
   glEnable(GL_DEPTH_TEST);
 
+  // Nothing here blocks: shaders compile over the first frames and the
+  // meshes load on worker threads, uploaded once the shaders exist
   for (std::string program : m_programNames)
   {
-    m_programs.push_back(
-        createProgramFromFile(getAssetsPath() + "shaders/" + program + ".vert",
-                              getAssetsPath() + "shaders/" + program + ".frag"));
+    m_loader.enqueue(
+        [this, program]
+        {
+          auto &shader{m_shaders.emplace_back()};
+          shader.load(
+              getAssetsPath() + "shaders/" + program + ".vert",
+              getAssetsPath() + "shaders/" + program + ".frag",
+              [this](std::string_view vertexSource,
+                     std::string_view fragmentSource)
+              { return createProgramFromString(vertexSource, fragmentSource); },
+              [](Program &created)
+              {
+                created.bindUniformBlock("FrameUniforms", frameUniformsBinding);
+                created.bindUniformBlock("DrawUniforms", drawUniformsBinding);
+                created.bindUniformBlock("PartColors", partColorsBinding);
+              });
+
+          // Compile the variants the objects pick from ahead of the first
+          // draw; shaders without DIFFUSE_MAP code get two equal programs
+          (void)shader.get();
+          (void)shader.get(shaderdefines::diffuseMap);
+        });
+  }
+  if (const auto *env{std::getenv("ABCG_TICK_RATE")})
+  {
+    if (const auto rate{std::atof(env)}; rate > 0.0)
+      m_tickRate = rate;
   }
-  m_testarossaProgram = m_programs.at(0);
-  m_labirintoProgram = m_programs.at(2);
 
-  m_labirinto.loadDiffuseTexture(getAssetsPath() + "maps/labirinto.jpg");
-  m_testarossa.loadObj(getAssetsPath() + "testarossa.obj", false);
-  m_labirinto.loadObj(getAssetsPath() + "labirinto.obj", false);
+  m_uniforms.initializeGL(uniformStreamSize);
 
-  m_testarossa.setupVAO(m_testarossaProgram);
-  m_labirinto.setupVAO(m_labirintoProgram);
+  // Meshes without parts still need a buffer behind the PartColors block
+  const PartColors noPartColors;
+  abcg::glGenBuffers(1, &m_noPartColorsUBO);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, m_noPartColorsUBO);
+  abcg::glBufferData(GL_UNIFORM_BUFFER, sizeof(noPartColors), &noPartColors,
+                     GL_STATIC_DRAW);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  abcg::glBindBufferBase(GL_UNIFORM_BUFFER, partColorsBinding,
+                         m_noPartColorsUBO);
+  m_sceneTimer.initializeGL();
+  samplers::initializeGL();
+
+  const auto assetsPath{getAssetsPath()};
+  m_loader.load(
+      [this, assetsPath]
+      { m_testarossa.readObj(assetsPath + "testarossa.obj", false, true); },
+      [this]
+      {
+        m_testarossa.uploadGL();
+        m_testarossa.setupVAO(m_shaders.at(m_testarossaProgram)
+                                  .get(m_testarossa.shaderDefines()));
+        m_testarossaReady = true;
+      });
+  m_loader.load(
+      [this, assetsPath]
+      {
+        m_labirinto.readDiffuseTexture(assetsPath + "maps/labirinto.jpg");
+        m_labirinto.readObj(assetsPath + "labirinto.obj", false, true);
+
+        const auto positions{m_labirinto.positions()};
+        m_collision.build(positions, m_labirinto.indices(),
+                          m_labirinto.getModelMatrix(), collisionCellSize);
+        m_labirinto.bakeVisibility(m_collision);
+        if (std::getenv("ABCG_COLLISION_BENCHMARK") != nullptr)
+          benchmarkCollision(positions, m_labirinto.indices(),
+                             m_labirinto.getModelMatrix(), collisionCellSize);
+      },
+      [this]
+      {
+        m_labirinto.uploadGL();
+        m_labirinto.setupVAO(
+            m_shaders.at(m_labirintoProgram).get(m_labirinto.shaderDefines()));
+        m_labirintoReady = true;
+      });
 
   resizeGL(getWindowSettings().width, getWindowSettings().height);
 }
 
 void OpenGLWindow::paintGL()
 {
+  // Uploads bind textures and buffers behind the state cache
+  if (m_loader.isLoading())
+  {
+    m_loader.drain(loadBudget);
+    glstate::invalidate();
+  }
+
   update();
 
   // Clear color buffer and depth buffer
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glViewport(0, 0, m_viewportWidth, m_viewportHeight);
-  m_labirinto.paintGL(m_labirintoProgram, m_camera.m_viewMatrix, m_camera.m_projMatrix, m_lightDir.x, m_Ia.x, m_Id.x, m_Is.x);
-  m_testarossa.paintGL(m_testarossaProgram, m_camera.m_viewMatrix, m_camera.m_projMatrix, m_kart.m_modelMatrix, m_lightDir.x, m_Ia.x, m_Id.x, m_Is.x);
-  glUseProgram(0);
+
+  // Camera and light once for every program
+  FrameUniforms frame;
+  frame.viewMatrix = m_camera.m_viewMatrix;
+  frame.projMatrix = m_camera.m_projMatrix;
+  frame.viewProjMatrix = m_camera.m_projMatrix * m_camera.m_viewMatrix;
+  frame.lightDirViewSpace = m_camera.m_viewMatrix * m_lightDir;
+  frame.Ia = m_Ia;
+  frame.Id = m_Id;
+  frame.Is = m_Is;
+  m_uniforms.begin();
+  m_uniforms.push(frameUniformsBinding, frame);
+
+  m_sceneTimer.begin();
+  if (m_depthPrepass && m_depthProgram < m_shaders.size())
+  {
+    // Depth first, then shade only the fragments that end up visible
+    abcg::glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    paintScene(m_depthProgram, m_depthProgram);
+
+    abcg::glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    abcg::glDepthFunc(GL_EQUAL);
+    abcg::glDepthMask(GL_FALSE);
+    paintScene(m_labirintoProgram, m_testarossaProgram);
+
+    abcg::glDepthMask(GL_TRUE);
+    abcg::glDepthFunc(GL_LESS);
+  }
+  else
+  {
+    paintScene(m_labirintoProgram, m_testarossaProgram);
+  }
+  m_sceneTimer.end();
+
+  // Buffer uploads must not change the element buffer of a vertex array
+  glstate::bindVertexArray(0);
+}
+
+void OpenGLWindow::paintScene(std::size_t labirintoProgram,
+                              std::size_t testarossaProgram)
+{
+  if (m_labirintoReady)
+    m_labirinto.paintGL(
+        m_shaders.at(labirintoProgram).get(m_labirinto.shaderDefines()),
+        m_uniforms, m_camera.m_viewMatrix, m_camera.m_projMatrix);
+  if (m_testarossaReady)
+    m_testarossa.paintGL(
+        m_shaders.at(testarossaProgram).get(m_testarossa.shaderDefines()),
+        m_uniforms, m_camera.m_viewMatrix, m_camera.m_projMatrix,
+        m_kart.m_modelMatrix);
 }
 
 void OpenGLWindow::paintUI()
 {
   abcg::OpenGLWindow::paintUI();
 
+  // Placeholder until every asset is uploaded
+  if (m_loader.isLoading())
+  {
+    auto widgetSize{ImVec2(120, 30)};
+    ImGui::SetNextWindowPos(ImVec2(5, m_viewportHeight - widgetSize.y - 5));
+    ImGui::SetNextWindowSize(widgetSize);
+    ImGui::Begin("Loading", nullptr, ImGuiWindowFlags_NoDecoration);
+    ImGui::Text("Carregando...");
+    ImGui::End();
+  }
+
   if (m_mostrarMenu)
   {
     auto widgetSize{ImVec2(200, 40)};
@@ -97,7 +230,24 @@ void OpenGLWindow::paintUI()
         ImGui::EndCombo();
       }
       ImGui::PopItemWidth();
-      m_testarossaProgram = m_programs.at(currentIndex);
+      if (currentIndex < m_shaders.size())
+        m_testarossaProgram = currentIndex;
+    }
+    ImGui::End();
+  }
+
+  if (m_mostrarMenu)
+  {
+    auto widgetSize{ImVec2(200, 60)};
+    ImGui::SetNextWindowPos(ImVec2(m_viewportWidth - widgetSize.x - 5, 50));
+    ImGui::SetNextWindowSize(widgetSize);
+    ImGui::Begin("Depth Prepass", nullptr, ImGuiWindowFlags_NoDecoration);
+    {
+      ImGui::Checkbox("Pré-passo de profundidade", &m_depthPrepass);
+      if (m_sceneTimer.isSupported())
+        ImGui::Text("Cena na GPU: %.2f ms", m_sceneTimer.milliseconds());
+      else
+        ImGui::Text("Cena na GPU: indisponível");
     }
     ImGui::End();
   }
@@ -137,7 +287,9 @@ void OpenGLWindow::paintUI()
       ImGui::PushItemWidth(widgetSize.x - 12);
       ImGui::SliderFloat("Shininess", &shininess, 0.0f, 500.0f, "%.1f");
       ImGui::PopItemWidth();
-      m_labirinto.setShininess(shininess);
+      // The loader thread writes the maze until it is ready
+      if (m_labirintoReady)
+        m_labirinto.setShininess(shininess);
     }
     ImGui::End();
   }
@@ -166,24 +318,59 @@ void OpenGLWindow::resizeGL(int width, int height)
 
 void OpenGLWindow::terminateGL()
 {
+  m_loader.shutdown();
   m_testarossa.terminateGL();
   m_labirinto.terminateGL();
+  m_uniforms.terminateGL();
+  abcg::glDeleteBuffers(1, &m_noPartColorsUBO);
+  m_sceneTimer.terminateGL();
+  for (auto &shader : m_shaders)
+    shader.terminateGL();
+  samplers::terminateGL();
+
+  const auto &stats{glstate::stats()};
+  fmt::print("GL state changes: {} issued, {} redundant skipped\n",
+             stats.issued, stats.skipped);
 }
 
 void OpenGLWindow::update()
 {
-  float deltaTime{static_cast<float>(getDeltaTime())};
-
   const float angle_offset = -90.0f;
-  const float aceleracao = 0.04f;
-  const float frenagem = 0.12f;
-  const float atrito = 0.01f;
+  const double tick{1.0 / m_tickRate};
+
+  m_accumulator += getDeltaTime();
+  int steps{};
+  while (m_accumulator >= tick)
+  {
+    if (steps == maxStepsPerFrame)
+    {
+      m_accumulator = 0.0;
+      break;
+    }
+    m_kart.storePreviousState();
+    step(static_cast<float>(tick));
+    m_accumulator -= tick;
+    ++steps;
+  }
+
+  // Draw the kart between the last two steps
+  m_kart.interpolate(static_cast<float>(m_accumulator / tick));
+  m_camera.centerKart(m_kart.m_renderPosition,
+                      m_kart.m_renderAngle + angle_offset);
+}
+
+void OpenGLWindow::step(float deltaTime)
+{
+  // Fraction of a reference frame in this step
+  const float frames{deltaTime * static_cast<float>(referenceRate)};
+
+  const float aceleracao = 0.04f * frames;
+  const float frenagem = 0.12f * frames;
+  const float atrito = 0.01f * frames;
   const float velocidade_min = 0.05f;
 
   deltaTime = deltaTime * 2.5f;
 
-  m_camera.centerKart(m_kart.m_position, m_kart.m_angle + angle_offset);
-
   // Atualiza a velocidade
   if (m_kart.m_acc == true && m_kart.m_dacc == false)
   {
@@ -236,7 +423,7 @@ void OpenGLWindow::update()
   // Atualiza o lado
   if (abs(m_kart.m_speed) > velocidade_min && m_kart.m_left == true && m_kart.m_right == false)
   {
-    m_kart.m_side += abs(1.0f - m_kart.m_side) * 0.1f + 0.05f;
+    m_kart.m_side += (abs(1.0f - m_kart.m_side) * 0.1f + 0.05f) * frames;
     if (m_kart.m_side > 1.0f)
     {
       m_kart.m_side = 1.0f;
@@ -244,7 +431,7 @@ void OpenGLWindow::update()
   }
   else if (abs(m_kart.m_speed) > velocidade_min && m_kart.m_left == false && m_kart.m_right == true)
   {
-    m_kart.m_side -= abs(-1.0f - m_kart.m_side) * 0.1f + 0.05f;
+    m_kart.m_side -= (abs(-1.0f - m_kart.m_side) * 0.1f + 0.05f) * frames;
     if (m_kart.m_side < -1.0f)
     {
       m_kart.m_side = -1.0f;
@@ -254,11 +441,11 @@ void OpenGLWindow::update()
   {
     if (m_kart.m_side < -velocidade_min)
     {
-      m_kart.m_side += abs(1.0f - m_kart.m_side) * 0.1f;
+      m_kart.m_side += abs(1.0f - m_kart.m_side) * 0.1f * frames;
     }
     else if (m_kart.m_side > velocidade_min)
     {
-      m_kart.m_side -= abs(-1.0f - m_kart.m_side) * 0.1f;
+      m_kart.m_side -= abs(-1.0f - m_kart.m_side) * 0.1f * frames;
     }
     else
     {
@@ -267,4 +454,6 @@ void OpenGLWindow::update()
   }
 
   m_kart.moveKart(m_kart.m_speed * deltaTime, m_kart.m_side * deltaTime);
+  if (m_labirintoReady)
+    m_kart.resolveCollisions(m_collision);
 }
@@ -3,10 +3,16 @@
 
 #include <string_view>
 #include "abcg.hpp"
+#include "assetloader.hpp"
 #include "camera.hpp"
+#include "collision.hpp"
+#include "gputimer.hpp"
 #include "labirinto.hpp"
 #include "kart.hpp"
+#include "program.hpp"
+#include "shadervariants.hpp"
 #include "testarossa.hpp"
+#include "uniformstream.hpp"
 
 class OpenGLWindow : public abcg::OpenGLWindow
 {
@@ -20,10 +26,23 @@ protected:
   void paintModel(GLuint m_program);
 
 private:
-  GLuint m_testarossaProgram{};
-  GLuint m_labirintoProgram{};
-  std::vector<GLuint> m_programs{};
-  std::vector<std::string> m_programNames{"phong", "blinnphong", "texture"};
+  // Indices into m_shaders; each object picks its variant with its
+  // shaderDefines(), by whether it has a diffuse texture
+  std::size_t m_testarossaProgram{0};
+  std::size_t m_labirintoProgram{2};
+  std::size_t m_depthProgram{3};
+  std::vector<ShaderVariants> m_shaders{};
+  std::vector<std::string> m_programNames{"phong", "blinnphong", "texture",
+                                          "depth"};
+
+  // Depth-only pass before shading, so that each pixel is shaded once
+  bool m_depthPrepass{false};
+  GpuTimer m_sceneTimer;
+
+  // Frame and draw uniform blocks, rewritten every frame
+  static constexpr GLsizeiptr uniformStreamSize{16 * 1024};
+  UniformStream m_uniforms;
+  GLuint m_noPartColorsUBO{};
 
   int m_viewportWidth{};
   int m_viewportHeight{};
@@ -31,16 +50,37 @@ private:
 
   Testarossa m_testarossa;
   Labirinto m_labirinto;
+  bool m_testarossaReady{false};
+  bool m_labirintoReady{false};
+
+  // Maze triangles in world space, built with the maze on the loader thread
+  static constexpr float collisionCellSize{1.0f};
+  CollisionMesh m_collision;
+
+  // Asset uploads per frame, in seconds
+  static constexpr double loadBudget{0.004};
+  AssetLoader m_loader;
   Camera m_camera;
   Kart m_kart;
 
+  // Kart physics run in fixed steps of 1 / m_tickRate seconds, set with
+  // ABCG_TICK_RATE; the handling constants are per step at referenceRate.
+  // Frames slower than maxStepsPerFrame steps drop the remaining time.
+  static constexpr double referenceRate{60.0};
+  static constexpr int maxStepsPerFrame{8};
+  double m_tickRate{120.0};
+  double m_accumulator{};
+
   // Light and material properties
   glm::vec4 m_lightDir{6.0f, 4.0f, -2.0f, 1.0f};
   glm::vec4 m_Ia{1.0f, 1.0f, 1.0f, 1.0f};
   glm::vec4 m_Id{1.0f, 1.0f, 1.0f, 1.0f};
   glm::vec4 m_Is{1.0f, 1.0f, 1.0f, 1.0f};
 
+  // Draws the maze and the kart with the programs at these indices
+  void paintScene(std::size_t labirintoProgram, std::size_t testarossaProgram);
   void update();
+  void step(float deltaTime);
 };
 
 #endif
\ No newline at end of file
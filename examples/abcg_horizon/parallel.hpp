@@ -0,0 +1,56 @@
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of workers to use for a requested numThreads; 0 picks the number of
+// hardware threads
+[[nodiscard]] inline std::size_t resolveThreadCount(std::size_t numThreads)
+{
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  return numThreads;
+}
+
+// Calls function(chunk) for every chunk in [0, numChunks), each on its own
+// thread; the calling thread takes chunk 0. Runs serially on builds without
+// threads.
+template <typename Function>
+void runChunks(std::size_t numChunks, const Function &function)
+{
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  for (std::size_t chunk{}; chunk < numChunks; ++chunk)
+    function(chunk);
+#else
+  std::vector<std::thread> workers;
+  workers.reserve(numChunks);
+  for (std::size_t chunk{1}; chunk < numChunks; ++chunk)
+    workers.emplace_back(function, chunk);
+  if (numChunks > 0)
+    function(0);
+  for (auto &worker : workers)
+    worker.join();
+#endif
+}
+
+// Splits [0, count) into at most numThreads contiguous ranges of at least
+// minChunkSize elements and calls function(first, last) on each in parallel
+template <typename Function>
+void parallelFor(std::size_t count, std::size_t numThreads,
+                 std::size_t minChunkSize, const Function &function)
+{
+  const auto numChunks{std::clamp<std::size_t>(
+      count / std::max<std::size_t>(minChunkSize, 1), 1,
+      resolveThreadCount(numThreads))};
+  runChunks(numChunks,
+            [&](std::size_t chunk)
+            {
+              function(count * chunk / numChunks,
+                       count * (chunk + 1) / numChunks);
+            });
+}
+
+#endif
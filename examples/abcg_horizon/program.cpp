@@ -0,0 +1,157 @@
+#include "program.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "glstate.hpp"
+
+namespace
+{
+// Active resources of one kind, sorted by name
+template <typename GetActive, typename GetLocation>
+std::vector<std::pair<std::string, GLint>>
+reflect(GLuint program, GLenum countQuery, GLenum maxLengthQuery,
+        GetActive getActive, GetLocation getLocation)
+{
+  GLint count{};
+  GLint maxLength{};
+  abcg::glGetProgramiv(program, countQuery, &count);
+  abcg::glGetProgramiv(program, maxLengthQuery, &maxLength);
+
+  std::vector<std::pair<std::string, GLint>> locations;
+  std::string name(static_cast<std::size_t>(std::max(maxLength, 1)), '\0');
+  for (GLint index{}; index < count; ++index)
+  {
+    GLsizei length{};
+    GLint size{};
+    GLenum type{};
+    getActive(program, static_cast<GLuint>(index), maxLength, &length, &size,
+              &type, name.data());
+
+    // Uniforms in blocks have no location
+    const GLint location{getLocation(program, name.c_str())};
+    if (location < 0)
+      continue;
+
+    std::string key{name.data(), static_cast<std::size_t>(length)};
+    if (key.ends_with("[0]"))
+      key.resize(key.size() - 3);
+    locations.emplace_back(std::move(key), location);
+  }
+
+  std::sort(locations.begin(), locations.end());
+  return locations;
+}
+} // namespace
+
+Program::Program(GLuint id) : m_id{id}
+{
+  m_uniforms = reflect(id, GL_ACTIVE_UNIFORMS, GL_ACTIVE_UNIFORM_MAX_LENGTH,
+                       abcg::glGetActiveUniform, abcg::glGetUniformLocation);
+  m_attributes =
+      reflect(id, GL_ACTIVE_ATTRIBUTES, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH,
+              abcg::glGetActiveAttrib, abcg::glGetAttribLocation);
+
+  GLint maxLocation{-1};
+  for (const auto &[name, location] : m_uniforms)
+    maxLocation = std::max(maxLocation, location);
+  m_values.resize(static_cast<std::size_t>(maxLocation + 1));
+}
+
+void Program::use() const { glstate::useProgram(m_id); }
+
+GLint Program::uniform(std::string_view name) const
+{
+  return find(m_uniforms, name);
+}
+
+GLint Program::attribute(std::string_view name) const
+{
+  return find(m_attributes, name);
+}
+
+void Program::bindUniformBlock(std::string_view name, GLuint binding) const
+{
+  const GLuint index{
+      abcg::glGetUniformBlockIndex(m_id, std::string{name}.c_str())};
+  if (index != GL_INVALID_INDEX)
+    abcg::glUniformBlockBinding(m_id, index, binding);
+}
+
+GLint Program::find(const Locations &locations, std::string_view name)
+{
+  const auto it{std::lower_bound(
+      locations.begin(), locations.end(), name,
+      [](const auto &entry, std::string_view key) { return entry.first < key; })};
+  if (it == locations.end() || it->first != name)
+    return -1;
+  return it->second;
+}
+
+bool Program::changed(GLint location, const void *value, std::size_t size)
+{
+  if (location < 0)
+    return false;
+  if (static_cast<std::size_t>(location) >= m_values.size())
+    return true;
+
+  auto &cached{m_values[static_cast<std::size_t>(location)]};
+  if (cached.valid && std::memcmp(cached.bytes.data(), value, size) == 0)
+    return false;
+  std::memcpy(cached.bytes.data(), value, size);
+  cached.valid = true;
+  return true;
+}
+
+void Program::set(GLint location, int value)
+{
+  if (changed(location, &value, sizeof(value)))
+    abcg::glUniform1i(location, value);
+}
+
+void Program::set(GLint location, float value)
+{
+  if (changed(location, &value, sizeof(value)))
+    abcg::glUniform1f(location, value);
+}
+
+void Program::set(GLint location, const glm::vec2 &value)
+{
+  if (changed(location, &value, sizeof(value)))
+    abcg::glUniform2fv(location, 1, &value.x);
+}
+
+void Program::set(GLint location, const glm::vec3 &value)
+{
+  if (changed(location, &value, sizeof(value)))
+    abcg::glUniform3fv(location, 1, &value.x);
+}
+
+void Program::set(GLint location, const glm::vec4 &value)
+{
+  if (changed(location, &value, sizeof(value)))
+    abcg::glUniform4fv(location, 1, &value.x);
+}
+
+void Program::set(GLint location, const glm::mat3 &value)
+{
+  if (changed(location, &value, sizeof(value)))
+    abcg::glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Program::set(GLint location, const glm::mat4 &value)
+{
+  if (changed(location, &value, sizeof(value)))
+    abcg::glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Program::set(GLint location, const glm::vec4 *values, std::size_t count)
+{
+  if (location < 0)
+    return;
+  abcg::glUniform4fv(location, static_cast<GLsizei>(count), &values->x);
+
+  // The first element shares the location of the array
+  if (static_cast<std::size_t>(location) < m_values.size())
+    m_values[static_cast<std::size_t>(location)].valid = false;
+}
@@ -0,0 +1,72 @@
+#ifndef PROGRAM_HPP_
+#define PROGRAM_HPP_
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "abcg.hpp"
+
+// A linked shader program with the locations of its active uniforms and
+// attributes, queried once with glGetActiveUniform/glGetActiveAttrib instead
+// of a glGet*Location call by name on every frame.
+//
+// The setters remember the last value sent to each location and skip the
+// glUniform call when it has not changed, so every user of a GL program must
+// share the same Program object. They apply to the program in use.
+class Program
+{
+public:
+  Program() = default;
+  explicit Program(GLuint id);
+  Program(const Program &) = delete;
+  Program &operator=(const Program &) = delete;
+  Program(Program &&) = default;
+  Program &operator=(Program &&) = default;
+
+  [[nodiscard]] GLuint id() const { return m_id; }
+  void use() const;
+
+  // Location of an active uniform or attribute, or -1 if the program has
+  // none by that name. Arrays are found by their name without "[0]".
+  [[nodiscard]] GLint uniform(std::string_view name) const;
+  [[nodiscard]] GLint attribute(std::string_view name) const;
+
+  // Points a uniform block at a buffer binding, if the program has it
+  void bindUniformBlock(std::string_view name, GLuint binding) const;
+
+  void set(GLint location, int value);
+  void set(GLint location, float value);
+  void set(GLint location, const glm::vec2 &value);
+  void set(GLint location, const glm::vec3 &value);
+  void set(GLint location, const glm::vec4 &value);
+  void set(GLint location, const glm::mat3 &value);
+  void set(GLint location, const glm::mat4 &value);
+
+  // Arrays are uploaded every time
+  void set(GLint location, const glm::vec4 *values, std::size_t count);
+
+private:
+  using Locations = std::vector<std::pair<std::string, GLint>>;
+
+  // Last value sent to a location
+  struct CachedValue
+  {
+    std::array<std::byte, sizeof(glm::mat4)> bytes{};
+    bool valid{false};
+  };
+
+  GLuint m_id{};
+  Locations m_uniforms;
+  Locations m_attributes;
+  std::vector<CachedValue> m_values;
+
+  [[nodiscard]] static GLint find(const Locations &locations,
+                                  std::string_view name);
+  bool changed(GLint location, const void *value, std::size_t size);
+};
+
+#endif
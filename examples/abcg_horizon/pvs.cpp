@@ -0,0 +1,127 @@
+#include "pvs.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+// Eye points per cell and target points per chunk
+constexpr int eyeSamples{4};
+constexpr int targetSamples{16};
+} // namespace
+
+void Pvs::bake(const CollisionMesh &mesh, const std::vector<IndexRange> &chunks,
+               float cellSize, float eyeMin, float eyeMax)
+{
+  m_bits.clear();
+  m_cells = {};
+  m_words = (chunks.size() + 63) / 64;
+  if (mesh.triangleCount() == 0 || chunks.empty())
+    return;
+
+  const auto &bounds{mesh.bounds()};
+  m_origin = {bounds.min.x, bounds.min.z};
+  m_cellSize = cellSize;
+  m_cells = glm::max(glm::ivec2{glm::ceil(glm::vec2{bounds.max.x - bounds.min.x,
+                                                    bounds.max.z - bounds.min.z} /
+                                          cellSize)},
+                     glm::ivec2{1});
+
+  // Chunk of every triangle, and fixed points spread over each chunk
+  std::vector<std::uint32_t> chunkOf(mesh.triangleCount());
+  std::vector<glm::vec3> targets;
+  targets.reserve(chunks.size() * targetSamples);
+  std::mt19937 random{1234u};
+  std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+  for (std::size_t chunk{}; chunk < chunks.size(); ++chunk)
+  {
+    const auto first{chunks[chunk].first / 3};
+    const auto count{chunks[chunk].count / 3};
+    std::fill_n(chunkOf.begin() + static_cast<std::ptrdiff_t>(first), count,
+                static_cast<std::uint32_t>(chunk));
+
+    for (int sample{}; sample < targetSamples; ++sample)
+    {
+      const auto &[a, b, c]{mesh.triangle(
+          first + std::min(static_cast<std::size_t>(
+                               unit(random) * static_cast<float>(count)),
+                           count - 1))};
+      auto u{unit(random)};
+      auto v{unit(random)};
+      if (u + v > 1.0f)
+      {
+        u = 1.0f - u;
+        v = 1.0f - v;
+      }
+      targets.push_back(a + (b - a) * u + (c - a) * v);
+    }
+  }
+
+  // Rays from each cell to every target; whatever they hit first is visible
+  std::vector<std::uint64_t> sampled(cellCount() * m_words, 0);
+  for (int z{}; z < m_cells.y; ++z)
+  {
+    for (int x{}; x < m_cells.x; ++x)
+    {
+      auto *bits{&sampled[(static_cast<std::size_t>(z) * m_cells.x + x) *
+                          m_words]};
+      for (int sample{}; sample < eyeSamples; ++sample)
+      {
+        const glm::vec3 eye{
+            m_origin.x + (static_cast<float>(x) + unit(random)) * m_cellSize,
+            bounds.min.y + eyeMin + (eyeMax - eyeMin) * unit(random),
+            m_origin.y + (static_cast<float>(z) + unit(random)) * m_cellSize};
+        for (std::size_t target{}; target < targets.size(); ++target)
+        {
+          const auto offset{targets[target] - eye};
+          const auto distance{glm::length(offset)};
+          if (distance < 1e-4f)
+            continue;
+
+          const auto hit{
+              mesh.raycast(eye, offset / distance, distance + 1e-3f)};
+          const auto chunk{hit ? chunkOf[hit->triangle]
+                               : target / targetSamples};
+          bits[chunk / 64] |= std::uint64_t{1} << (chunk % 64);
+        }
+      }
+    }
+  }
+
+  // Merge each cell with its neighbours
+  m_bits.assign(sampled.size(), 0);
+  for (int z{}; z < m_cells.y; ++z)
+  {
+    for (int x{}; x < m_cells.x; ++x)
+    {
+      auto *bits{&m_bits[(static_cast<std::size_t>(z) * m_cells.x + x) *
+                         m_words]};
+      for (int nz{std::max(z - 1, 0)}; nz <= std::min(z + 1, m_cells.y - 1);
+           ++nz)
+      {
+        for (int nx{std::max(x - 1, 0)};
+             nx <= std::min(x + 1, m_cells.x - 1); ++nx)
+        {
+          const auto *neighbour{
+              &sampled[(static_cast<std::size_t>(nz) * m_cells.x + nx) *
+                       m_words]};
+          for (std::size_t word{}; word < m_words; ++word)
+            bits[word] |= neighbour[word];
+        }
+      }
+    }
+  }
+}
+
+const std::uint64_t *Pvs::find(const glm::vec3 &point) const
+{
+  if (m_bits.empty())
+    return nullptr;
+
+  const glm::ivec2 cell{
+      glm::floor((glm::vec2{point.x, point.z} - m_origin) / m_cellSize)};
+  if (cell.x < 0 || cell.y < 0 || cell.x >= m_cells.x || cell.y >= m_cells.y)
+    return nullptr;
+  return &m_bits[(static_cast<std::size_t>(cell.y) * m_cells.x + cell.x) *
+                 m_words];
+}
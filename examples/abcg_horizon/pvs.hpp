@@ -0,0 +1,50 @@
+#ifndef PVS_HPP_
+#define PVS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "abcg.hpp"
+#include "collision.hpp"
+#include "vertexcache.hpp"
+
+// Potentially visible sets: the floor under a mesh split into square cells,
+// each with a bitset of the chunks that can be seen from inside it
+class Pvs
+{
+public:
+  // Casts rays from eye points spread over each cell, between eyeMin and
+  // eyeMax above the floor, to points on every chunk; a chunk is visible if
+  // some ray hits it first. chunks are ranges of the indices the mesh was
+  // built from. Each set also takes in its neighbours, since sampling can
+  // miss chunks seen through narrow gaps.
+  void bake(const CollisionMesh &mesh, const std::vector<IndexRange> &chunks,
+            float cellSize, float eyeMin, float eyeMax);
+
+  // Chunks visible from point, one bit per chunk, or nullptr when point is
+  // outside every cell and anything may be visible
+  [[nodiscard]] const std::uint64_t *find(const glm::vec3 &point) const;
+
+  [[nodiscard]] static bool isVisible(const std::uint64_t *bits,
+                                      std::size_t chunk)
+  {
+    return (bits[chunk / 64] >> (chunk % 64) & 1u) != 0;
+  }
+
+  [[nodiscard]] std::size_t cellCount() const
+  {
+    return static_cast<std::size_t>(m_cells.x) * m_cells.y;
+  }
+
+private:
+  glm::vec2 m_origin{};
+  float m_cellSize{1.0f};
+  glm::ivec2 m_cells{};
+
+  // Bitset of cell i starts at m_bits[i * m_words]
+  std::size_t m_words{};
+  std::vector<std::uint64_t> m_bits;
+};
+
+#endif
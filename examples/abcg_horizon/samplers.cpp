@@ -0,0 +1,73 @@
+#include "samplers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+// From EXT_texture_filter_anisotropic, core since OpenGL 4.6
+constexpr GLenum textureMaxAnisotropy{0x84FE};
+constexpr GLenum maxTextureMaxAnisotropy{0x84FF};
+constexpr float maxAnisotropy{8.0f};
+
+std::array<GLuint, 3> samplerObjects{};
+
+bool hasExtension(const char *name)
+{
+  GLint count{};
+  abcg::glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint index{}; index < count; ++index)
+  {
+    const auto *extension{reinterpret_cast<const char *>(
+        abcg::glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(index)))};
+    if (extension != nullptr && std::strcmp(extension, name) == 0)
+      return true;
+  }
+  return false;
+}
+
+void setFilter(GLuint sampler, GLint minFilter, GLint wrap)
+{
+  abcg::glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, minFilter);
+  abcg::glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  abcg::glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, wrap);
+  abcg::glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, wrap);
+  abcg::glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, wrap);
+}
+} // namespace
+
+namespace samplers
+{
+void initializeGL()
+{
+  abcg::glGenSamplers(static_cast<GLsizei>(samplerObjects.size()),
+                      samplerObjects.data());
+
+  setFilter(get(Sampler::LinearMipRepeat), GL_LINEAR_MIPMAP_LINEAR,
+            GL_REPEAT);
+  setFilter(get(Sampler::Anisotropic), GL_LINEAR_MIPMAP_LINEAR, GL_REPEAT);
+  setFilter(get(Sampler::Clamp), GL_LINEAR, GL_CLAMP_TO_EDGE);
+
+  if (hasExtension("GL_EXT_texture_filter_anisotropic") ||
+      hasExtension("GL_ARB_texture_filter_anisotropic"))
+  {
+    GLfloat supported{1.0f};
+    abcg::glGetFloatv(maxTextureMaxAnisotropy, &supported);
+    abcg::glSamplerParameterf(get(Sampler::Anisotropic), textureMaxAnisotropy,
+                              std::min(supported, maxAnisotropy));
+  }
+}
+
+void terminateGL()
+{
+  abcg::glDeleteSamplers(static_cast<GLsizei>(samplerObjects.size()),
+                         samplerObjects.data());
+  samplerObjects.fill(0);
+}
+
+GLuint get(Sampler sampler)
+{
+  return samplerObjects.at(static_cast<std::size_t>(sampler));
+}
+} // namespace samplers
@@ -0,0 +1,24 @@
+#ifndef SAMPLERS_HPP_
+#define SAMPLERS_HPP_
+
+#include "abcg.hpp"
+
+// Sampler objects shared by every texture. Textures keep no filtering or
+// wrapping state of their own; the sampler bound to their unit decides it.
+enum class Sampler
+{
+  LinearMipRepeat, // Trilinear, repeating
+  Anisotropic,     // LinearMipRepeat with anisotropic filtering, if supported
+  Clamp            // Bilinear, clamped to the edges, for cube maps
+};
+
+namespace samplers
+{
+// Creates the samplers; must run on the GL thread before get()
+void initializeGL();
+void terminateGL();
+
+[[nodiscard]] GLuint get(Sampler sampler);
+} // namespace samplers
+
+#endif
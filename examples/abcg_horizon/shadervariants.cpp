@@ -0,0 +1,75 @@
+#include "shadervariants.hpp"
+
+#include <fmt/core.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+std::string readSource(const std::string &path)
+{
+  std::ifstream stream{path};
+  if (!stream)
+  {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to open shader {}", path))};
+  }
+  std::stringstream source;
+  source << stream.rdbuf();
+  return source.str();
+}
+
+// Source with a #define line per name, right after the #version line
+std::string specialize(std::string_view source, std::string_view defines)
+{
+  std::string lines;
+  while (!defines.empty())
+  {
+    const auto end{defines.find(' ')};
+    const auto name{defines.substr(0, end)};
+    if (!name.empty())
+      lines += fmt::format("#define {}\n", name);
+    defines.remove_prefix(end == std::string_view::npos ? defines.size()
+                                                        : end + 1);
+  }
+
+  const auto versionEnd{source.starts_with("#version") ? source.find('\n')
+                                                       : std::string_view::npos};
+  if (versionEnd == std::string_view::npos)
+    return lines + std::string{source};
+  return std::string{source.substr(0, versionEnd + 1)} + lines +
+         std::string{source.substr(versionEnd + 1)};
+}
+} // namespace
+
+void ShaderVariants::load(const std::string &vertexPath,
+                          const std::string &fragmentPath, Compiler compile,
+                          Setup setup)
+{
+  terminateGL();
+  m_vertexSource = readSource(vertexPath);
+  m_fragmentSource = readSource(fragmentPath);
+  m_compile = std::move(compile);
+  m_setup = std::move(setup);
+}
+
+void ShaderVariants::terminateGL()
+{
+  for (const auto &[defines, program] : m_variants)
+    abcg::glDeleteProgram(program.id());
+  m_variants.clear();
+}
+
+Program &ShaderVariants::get(std::string_view defines)
+{
+  if (const auto found{m_variants.find(defines)}; found != m_variants.end())
+    return found->second;
+
+  Program program{m_compile(specialize(m_vertexSource, defines),
+                            specialize(m_fragmentSource, defines))};
+  if (m_setup)
+    m_setup(program);
+  return m_variants.emplace(std::string{defines}, std::move(program))
+      .first->second;
+}
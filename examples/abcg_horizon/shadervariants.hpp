@@ -0,0 +1,51 @@
+#ifndef SHADERVARIANTS_HPP_
+#define SHADERVARIANTS_HPP_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "abcg.hpp"
+#include "program.hpp"
+
+// One vertex/fragment shader pair compiled into specialized programs, one per
+// set of #define names, so that material options are resolved by the shader
+// compiler instead of by branches on uniforms
+class ShaderVariants
+{
+public:
+  // Builds a program from vertex and fragment shader sources
+  using Compiler = std::function<GLuint(std::string_view, std::string_view)>;
+  // Called once on every new variant, e.g. to bind its uniform blocks
+  using Setup = std::function<void(Program &)>;
+
+  // Reads the sources; nothing is compiled until a variant is requested
+  void load(const std::string &vertexPath, const std::string &fragmentPath,
+            Compiler compile, Setup setup = {});
+  void terminateGL();
+
+  // Program with the space-separated names in defines defined, compiled on
+  // first use. The same set must always be written in the same order.
+  [[nodiscard]] Program &get(std::string_view defines = {});
+
+  [[nodiscard]] std::size_t variantCount() const { return m_variants.size(); }
+
+private:
+  std::string m_vertexSource;
+  std::string m_fragmentSource;
+  Compiler m_compile;
+  Setup m_setup;
+
+  std::map<std::string, Program, std::less<>> m_variants;
+};
+
+// Defines understood by the horizon shaders
+namespace shaderdefines
+{
+// Sample diffuseTex at the mesh texture coordinates (texture.vert/.frag);
+// without it the material colors are used as they are
+constexpr std::string_view diffuseMap{"DIFFUSE_MAP"};
+} // namespace shaderdefines
+
+#endif
@@ -0,0 +1,301 @@
+#include "simplifier.hpp"
+
+#include <algorithm>
+#include <cppitertools/itertools.hpp>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+#include "vertexwelder.hpp"
+
+namespace
+{
+  // Symmetric 4x4 matrix of the sum of squared distances to a set of planes
+  struct Quadric
+  {
+    double a00{}, a01{}, a02{}, a03{};
+    double a11{}, a12{}, a13{};
+    double a22{}, a23{};
+    double a33{};
+
+    void addPlane(double a, double b, double c, double d, double weight)
+    {
+      a00 += weight * a * a;
+      a01 += weight * a * b;
+      a02 += weight * a * c;
+      a03 += weight * a * d;
+      a11 += weight * b * b;
+      a12 += weight * b * c;
+      a13 += weight * b * d;
+      a22 += weight * c * c;
+      a23 += weight * c * d;
+      a33 += weight * d * d;
+    }
+
+    Quadric &operator+=(const Quadric &other)
+    {
+      a00 += other.a00;
+      a01 += other.a01;
+      a02 += other.a02;
+      a03 += other.a03;
+      a11 += other.a11;
+      a12 += other.a12;
+      a13 += other.a13;
+      a22 += other.a22;
+      a23 += other.a23;
+      a33 += other.a33;
+      return *this;
+    }
+
+    [[nodiscard]] double error(const glm::vec3 &position) const
+    {
+      const double x{position.x};
+      const double y{position.y};
+      const double z{position.z};
+      return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z +
+             2.0 * a03 * x + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+             a22 * z * z + 2.0 * a23 * z + a33;
+    }
+  };
+
+  struct Collapse
+  {
+    GLuint from;
+    GLuint to;
+    double error;
+  };
+
+  // Vertices that lie on an edge not shared by exactly two triangles
+  std::vector<bool> findLockedVertices(std::size_t vertexCount,
+                                       const std::vector<GLuint> &indices)
+  {
+    VertexWelder<2> edges{indices.size()};
+    std::vector<unsigned> edgeTriangles;
+    std::vector<std::array<GLuint, 2>> edgeVertices;
+    for (std::size_t i{}; i < indices.size(); i += 3)
+    {
+      for (const auto j : {0, 1, 2})
+      {
+        const auto a{indices[i + j]};
+        const auto b{indices[i + (j + 1) % 3]};
+        const auto [edge, isNew]{
+            edges.insert({static_cast<std::int32_t>(std::min(a, b)),
+                          static_cast<std::int32_t>(std::max(a, b))})};
+        if (isNew)
+        {
+          edgeTriangles.push_back(0);
+          edgeVertices.push_back({a, b});
+        }
+        ++edgeTriangles[edge];
+      }
+    }
+
+    std::vector<bool> locked(vertexCount, false);
+    for (const auto edge : iter::range(edgeTriangles.size()))
+    {
+      if (edgeTriangles[edge] != 2)
+      {
+        locked[edgeVertices[edge][0]] = true;
+        locked[edgeVertices[edge][1]] = true;
+      }
+    }
+    return locked;
+  }
+
+  // Checks that moving from onto to flips none of the remaining triangles
+  bool flipsTriangles(const std::vector<glm::vec3> &positions,
+                      const std::vector<GLuint> &indices,
+                      const std::vector<std::size_t> &offsets,
+                      const std::vector<std::size_t> &adjacency, GLuint from,
+                      GLuint to)
+  {
+    for (auto k{offsets[from]}; k < offsets[from + 1]; ++k)
+    {
+      const auto *triangle{indices.data() + adjacency[k] * 3};
+      if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+        continue; // Collapses away
+
+      std::array<glm::vec3, 3> before{};
+      std::array<glm::vec3, 3> after{};
+      for (const auto j : {0, 1, 2})
+      {
+        before[j] = positions[triangle[j]];
+        after[j] = triangle[j] == from ? positions[to] : before[j];
+      }
+      const auto normalBefore{
+          glm::cross(before[1] - before[0], before[2] - before[0])};
+      const auto normalAfter{
+          glm::cross(after[1] - after[0], after[2] - after[0])};
+      if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+        return true;
+    }
+    return false;
+  }
+} // namespace
+
+std::vector<GLuint> simplify(const std::vector<glm::vec3> &positions,
+                             const GLuint *indices, std::size_t indexCount,
+                             std::size_t targetIndexCount, float maxError)
+{
+  if (indexCount <= targetIndexCount)
+    return {indices, indices + indexCount};
+
+  // Work on the vertices of this part only, so the arrays below are sized
+  // to the part rather than to the mesh
+  auto local{localizeIndices(indices, indexCount)};
+  auto &result{local.indices};
+  const auto vertexCount{local.vertices.size()};
+  std::vector<glm::vec3> partPositions;
+  partPositions.reserve(vertexCount);
+  for (const auto vertex : local.vertices)
+    partPositions.push_back(positions[vertex]);
+
+  // Errors are relative to the extent of the part
+  glm::vec3 max(std::numeric_limits<float>::lowest());
+  glm::vec3 min(std::numeric_limits<float>::max());
+  for (const auto index : result)
+  {
+    max = glm::max(max, partPositions[index]);
+    min = glm::min(min, partPositions[index]);
+  }
+  const double extent{glm::length(max - min)};
+  const auto errorLimit{static_cast<double>(maxError) * maxError * extent *
+                        extent};
+
+  // Area-weighted plane quadrics of the triangles around each vertex
+  std::vector<Quadric> quadrics(vertexCount);
+  for (std::size_t i{}; i < result.size(); i += 3)
+  {
+    const auto &a{partPositions[result[i + 0]]};
+    const auto &b{partPositions[result[i + 1]]};
+    const auto &c{partPositions[result[i + 2]]};
+    const auto normal{glm::cross(b - a, c - a)};
+    const double area{glm::length(normal)};
+    if (!(area > 0.0))
+      continue;
+
+    const auto unit{normal / static_cast<float>(area)};
+    const double d{-glm::dot(unit, a)};
+    for (const auto j : {0, 1, 2})
+      quadrics[result[i + j]].addPlane(unit.x, unit.y, unit.z, d, area);
+  }
+
+  const auto locked{findLockedVertices(vertexCount, result)};
+
+  std::vector<std::size_t> offsets(vertexCount + 1);
+  std::vector<std::size_t> adjacency;
+  std::vector<Collapse> collapses;
+  std::vector<GLuint> remap(vertexCount);
+  std::vector<bool> touched(vertexCount);
+
+  while (result.size() > targetIndexCount)
+  {
+    // Triangles around each vertex
+    std::fill(offsets.begin(), offsets.end(), 0);
+    for (const auto index : result)
+      ++offsets[index + 1];
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    adjacency.resize(result.size());
+    {
+      auto fill{offsets};
+      for (const auto i : iter::range(result.size()))
+        adjacency[fill[result[i]]++] = i / 3;
+    }
+
+    // Cheapest direction of each edge
+    collapses.clear();
+    for (std::size_t i{}; i < result.size(); i += 3)
+    {
+      for (const auto j : {0, 1, 2})
+      {
+        const auto a{result[i + j]};
+        const auto b{result[i + (j + 1) % 3]};
+        if (a > b)
+          continue; // The opposite half-edge handles it, if any
+
+        auto combined{quadrics[a]};
+        combined += quadrics[b];
+        Collapse best{a, b, std::numeric_limits<double>::max()};
+        if (!locked[a])
+          best = {a, b, combined.error(partPositions[b])};
+        if (!locked[b] && combined.error(partPositions[a]) < best.error)
+          best = {b, a, combined.error(partPositions[a])};
+        if (best.error <= errorLimit)
+          collapses.push_back(best);
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const auto &lhs, const auto &rhs)
+              { return lhs.error < rhs.error; });
+
+    // Each collapse removes about two triangles; a vertex moves at most once
+    // per pass so the adjacency above stays valid
+    std::iota(remap.begin(), remap.end(), 0);
+    std::fill(touched.begin(), touched.end(), false);
+    const auto wanted{(result.size() - targetIndexCount) / 6 + 1};
+    std::size_t collapsed{};
+    for (const auto &collapse : collapses)
+    {
+      if (collapsed >= wanted)
+        break;
+      if (touched[collapse.from] || touched[collapse.to])
+        continue;
+      if (flipsTriangles(partPositions, result, offsets, adjacency,
+                         collapse.from, collapse.to))
+        continue;
+
+      remap[collapse.from] = collapse.to;
+      quadrics[collapse.to] += quadrics[collapse.from];
+      for (auto k{offsets[collapse.from]}; k < offsets[collapse.from + 1]; ++k)
+        for (const auto j : {0, 1, 2})
+          touched[result[adjacency[k] * 3 + j]] = true;
+      ++collapsed;
+    }
+
+    if (collapsed == 0)
+      break;
+
+    // Rewrite the triangles and drop the degenerate ones
+    std::size_t write{};
+    for (std::size_t i{}; i < result.size(); i += 3)
+    {
+      const auto a{remap[result[i + 0]]};
+      const auto b{remap[result[i + 1]]};
+      const auto c{remap[result[i + 2]]};
+      if (a == b || b == c || a == c)
+        continue;
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  for (auto &index : result)
+    index = local.vertices[index];
+  return std::move(result);
+}
+
+void generateLods(const std::vector<glm::vec3> &positions,
+                  std::vector<GLuint> &indices,
+                  std::vector<IndexRange> &ranges, std::size_t levelCount,
+                  float ratio)
+{
+  const auto partCount{ranges.size()};
+  for (std::size_t level{1}; level < levelCount; ++level)
+  {
+    const auto previous{ranges.size() - partCount};
+    for (const auto part : iter::range(partCount))
+    {
+      const auto source{ranges[previous + part]};
+      const auto target{static_cast<std::size_t>(
+                            static_cast<float>(source.count / 3) * ratio) *
+                        3};
+      const auto simplified{simplify(positions, indices.data() + source.first,
+                                     source.count, target)};
+      ranges.push_back({indices.size(), simplified.size()});
+      indices.insert(indices.end(), simplified.begin(), simplified.end());
+    }
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef SIMPLIFIER_HPP_
+#define SIMPLIFIER_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "abcg.hpp"
+#include "vertexcache.hpp"
+
+// Simplifies a triangle list down to about targetIndexCount indices with
+// quadric error edge collapses. Vertices are neither moved nor created, so
+// the result indexes the same vertex array. Vertices on open or non-manifold
+// edges (borders of a part, normal or UV seams) are locked, so simplified
+// parts still meet each other. Collapses stop when the error would exceed
+// maxError, relative to the extent of the mesh.
+[[nodiscard]] std::vector<GLuint>
+simplify(const std::vector<glm::vec3> &positions, const GLuint *indices,
+         std::size_t indexCount, std::size_t targetIndexCount,
+         float maxError = 0.02f);
+
+// Appends levelCount - 1 levels of detail to indices. Each level simplifies
+// every range of the previous one to about ratio of its triangles, and its
+// ranges are appended to ranges in the same order, so range
+// level * parts + part is part at that level.
+void generateLods(const std::vector<glm::vec3> &positions,
+                  std::vector<GLuint> &indices,
+                  std::vector<IndexRange> &ranges, std::size_t levelCount,
+                  float ratio = 0.5f);
+
+#endif
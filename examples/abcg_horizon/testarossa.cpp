@@ -1,127 +1,82 @@
 #include "testarossa.hpp"
 
 #include <fmt/core.h>
-#include <tiny_obj_loader.h>
 
+#include <algorithm>
+#include <array>
 #include <cppitertools/itertools.hpp>
 #include <filesystem>
-#include <glm/gtx/hash.hpp>
-#include <unordered_map>
 #include <glm/gtc/matrix_inverse.hpp>
+#include <limits>
+#include <unordered_map>
 
-// Explicit specialization of std::hash for Vertex
-namespace std
+#include "glstate.hpp"
+#include "meshcache.hpp"
+#include "meshkernels.hpp"
+#include "objparser.hpp"
+#include "samplers.hpp"
+#include "simplifier.hpp"
+#include "texturedata.hpp"
+#include "vertexcache.hpp"
+#include "vertexwelder.hpp"
+
+void Testarossa::computeBounds()
 {
-  template <>
-  struct hash<Vertex>
-  {
-    size_t operator()(Vertex const &vertex) const noexcept
-    {
-      const std::size_t h1{std::hash<glm::vec3>()(vertex.position)};
-      const std::size_t h2{std::hash<glm::vec3>()(vertex.normal)};
-      const std::size_t h3{std::hash<glm::vec2>()(vertex.texCoord)};
-      return h1 ^ h2 ^ h3;
-    }
-  };
-} // namespace std
+  ::computeBounds(m_vertices, m_boundsMin, m_boundsMax);
+}
 
 void Testarossa::computeNormals()
 {
-  // Clear previous vertex normals
-  for (auto &vertex : m_vertices)
-  {
-    vertex.normal = glm::zero<glm::vec3>();
-  }
-
-  // Compute face normals
-  for (const auto offset : iter::range<int>(0, m_indices.size(), 3))
-  {
-    // Get face vertices
-    Vertex &a{m_vertices.at(m_indices.at(offset + 0))};
-    Vertex &b{m_vertices.at(m_indices.at(offset + 1))};
-    Vertex &c{m_vertices.at(m_indices.at(offset + 2))};
-
-    // Compute normal
-    const auto edge1{b.position - a.position};
-    const auto edge2{c.position - b.position};
-    glm::vec3 normal{glm::cross(edge1, edge2)};
-
-    // Accumulate on vertices
-    a.normal += normal;
-    b.normal += normal;
-    c.normal += normal;
-  }
+  ::computeNormals(m_vertices, m_indices);
+  m_hasNormals = true;
+}
 
-  // Normalize
-  for (auto &vertex : m_vertices)
+void Testarossa::computePartBounds()
+{
+  for (const auto part : iter::range(m_parts.size()))
   {
-    vertex.normal = glm::normalize(vertex.normal);
+    auto &bounds{m_parts.at(part)};
+    bounds.boundsMin = glm::vec3{std::numeric_limits<float>::max()};
+    bounds.boundsMax = glm::vec3{std::numeric_limits<float>::lowest()};
+    const auto &range{m_ranges.at(part)};
+    for (const auto i : iter::range(range.first, range.first + range.count))
+    {
+      const auto &position{m_vertices.at(m_indices.at(i)).position};
+      bounds.boundsMin = glm::min(bounds.boundsMin, position);
+      bounds.boundsMax = glm::max(bounds.boundsMax, position);
+    }
   }
-
-  m_hasNormals = true;
 }
 
 void Testarossa::computeTangents()
 {
-  // Reserve space for bitangents
-  std::vector<glm::vec3> bitangents(m_vertices.size(), glm::vec3(0));
-
-  // Compute face tangents and bitangents
-  for (const auto offset : iter::range<int>(0, m_indices.size(), 3))
-  {
-    // Get face indices
-    const auto i1{m_indices.at(offset + 0)};
-    const auto i2{m_indices.at(offset + 1)};
-    const auto i3{m_indices.at(offset + 2)};
-
-    // Get face vertices
-    Vertex &v1{m_vertices.at(i1)};
-    Vertex &v2{m_vertices.at(i2)};
-    Vertex &v3{m_vertices.at(i3)};
-
-    const auto e1{v2.position - v1.position};
-    const auto e2{v3.position - v1.position};
-    const auto delta1{v2.texCoord - v1.texCoord};
-    const auto delta2{v3.texCoord - v1.texCoord};
-
-    glm::mat2 M;
-    M[0][0] = delta2.t;
-    M[0][1] = -delta1.t;
-    M[1][0] = -delta2.s;
-    M[1][1] = delta1.s;
-    M *= (1.0f / (delta1.s * delta2.t - delta2.s * delta1.t));
-
-    const auto tangent{glm::vec4(M[0][0] * e1.x + M[0][1] * e2.x,
-                                 M[0][0] * e1.y + M[0][1] * e2.y,
-                                 M[0][0] * e1.z + M[0][1] * e2.z, 0.0f)};
-
-    const auto bitangent{glm::vec3(M[1][0] * e1.x + M[1][1] * e2.x,
-                                   M[1][0] * e1.y + M[1][1] * e2.y,
-                                   M[1][0] * e1.z + M[1][1] * e2.z)};
-
-    // Accumulate on vertices
-    v1.tangent += tangent;
-    v2.tangent += tangent;
-    v3.tangent += tangent;
-
-    bitangents.at(i1) += bitangent;
-    bitangents.at(i2) += bitangent;
-    bitangents.at(i3) += bitangent;
-  }
+  ::computeTangents(m_vertices, m_indices);
+}
 
-  for (auto &&[i, vertex] : iter::enumerate(m_vertices))
+void Testarossa::cullParts(const glm::mat4 &clipMatrix)
+{
+  m_partVisible.assign(m_parts.size(), true);
+  for (const auto part : iter::range(m_parts.size()))
   {
-    const auto &n{vertex.normal};
-    const auto &t{glm::vec3(vertex.tangent)};
+    const auto &min{m_parts.at(part).boundsMin};
+    const auto &max{m_parts.at(part).boundsMax};
 
-    // Orthogonalize t with respect to n
-    const auto tangent{t - n * glm::dot(n, t)};
-    vertex.tangent = glm::vec4(glm::normalize(tangent), 0);
-
-    // Compute handedness of re-orthogonalized basis
-    const auto b{glm::cross(n, t)};
-    const auto handedness{glm::dot(b, bitangents.at(i))};
-    vertex.tangent.w = (handedness < 0.0f) ? -1.0f : 1.0f;
+    // Count the box corners outside each clip plane
+    std::array<int, 6> outside{};
+    for (const auto corner : iter::range(8))
+    {
+      const glm::vec4 position{clipMatrix *
+                               glm::vec4{(corner & 1) ? max.x : min.x,
+                                         (corner & 2) ? max.y : min.y,
+                                         (corner & 4) ? max.z : min.z, 1.0f}};
+      for (const auto axis : iter::range(3))
+      {
+        outside.at(2 * axis) += position[axis] < -position.w ? 1 : 0;
+        outside.at(2 * axis + 1) += position[axis] > position.w ? 1 : 0;
+      }
+    }
+    m_partVisible.at(part) =
+        std::find(outside.begin(), outside.end(), 8) == outside.end();
   }
 }
 
@@ -129,21 +84,42 @@ void Testarossa::createBuffers()
 {
   // Delete previous buffers
   abcg::glDeleteBuffers(1, &m_EBO);
+  abcg::glDeleteBuffers(1, &m_partVBO);
+  abcg::glDeleteBuffers(1, &m_partColorsUBO);
   abcg::glDeleteBuffers(1, &m_VBO);
 
   // VBO
   abcg::glGenBuffers(1, &m_VBO);
   abcg::glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-  abcg::glBufferData(GL_ARRAY_BUFFER, sizeof(m_vertices[0]) * m_vertices.size(),
-                     m_vertices.data(), GL_STATIC_DRAW);
+  abcg::glBufferData(GL_ARRAY_BUFFER, m_vertexData.size(), m_vertexData.data(),
+                     GL_STATIC_DRAW);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  m_vertexData = {};
+
+  // Part of each vertex
+  abcg::glGenBuffers(1, &m_partVBO);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_partVBO);
+  abcg::glBufferData(GL_ARRAY_BUFFER, m_partData.size(), m_partData.data(),
+                     GL_STATIC_DRAW);
   abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  m_partData = {};
+
+  // Part colors, which only change with the mesh
+  PartColors partColors;
+  for (const auto part : iter::range(std::min(m_parts.size(), maxPartColors)))
+    partColors.colors[part] = m_parts.at(part).color;
+  abcg::glGenBuffers(1, &m_partColorsUBO);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, m_partColorsUBO);
+  abcg::glBufferData(GL_UNIFORM_BUFFER, sizeof(partColors), &partColors,
+                     GL_STATIC_DRAW);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
   // EBO
+  const auto &indexData{m_indexLayout.data()};
   abcg::glGenBuffers(1, &m_EBO);
   abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-  abcg::glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     sizeof(m_indices[0]) * m_indices.size(), m_indices.data(),
-                     GL_STATIC_DRAW);
+  abcg::glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(),
+                     indexData.data(), GL_STATIC_DRAW);
   abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
@@ -164,7 +140,7 @@ void Testarossa::loadDiffuseTexture(std::string_view path)
     return;
 
   abcg::glDeleteTextures(1, &m_diffuseTexture);
-  m_diffuseTexture = abcg::opengl::loadTexture(path);
+  m_diffuseTexture = createTexture(decodeTexture(path));
 }
 
 void Testarossa::loadNormalTexture(std::string_view path)
@@ -173,36 +149,168 @@ void Testarossa::loadNormalTexture(std::string_view path)
     return;
 
   abcg::glDeleteTextures(1, &m_normalTexture);
-  m_normalTexture = abcg::opengl::loadTexture(path);
+  m_normalTexture = createTexture(decodeTexture(path));
 }
 
-void Testarossa::loadObj(std::string_view path, bool standardize)
+void Testarossa::loadObj(std::string_view path, bool standardize,
+                         bool packVertices)
 {
-  const auto basePath{std::filesystem::path{path}.parent_path().string() + "/"};
+  readObj(path, standardize, packVertices);
+  uploadGL();
+}
+
+void Testarossa::prepareBuffers()
+{
+  // Narrow the indices, splitting large meshes into meshlets
+  m_indexLayout.build(m_vertices, m_indices, m_ranges);
+  const auto vertices{m_indexLayout.layoutVertices(m_vertices)};
+
+  // Parts past the size of the palette share its entries
+  std::vector<std::uint8_t> vertexParts(m_vertices.size());
+  const auto partCount{m_ranges.size() / m_lodCount};
+  for (const auto rangeIndex : iter::range(m_ranges.size()))
+  {
+    const auto &range{m_ranges.at(rangeIndex)};
+    const auto part{(rangeIndex % partCount) % maxPartColors};
+    for (const auto i : iter::range(range.first, range.first + range.count))
+      vertexParts.at(m_indices.at(i)) = static_cast<std::uint8_t>(part);
+  }
+  m_partData = m_indexLayout.layoutVertices(vertexParts);
 
-  tinyobj::ObjReaderConfig readerConfig;
-  readerConfig.mtl_search_path = basePath; // Path to material files
+  if (m_packVertices)
+  {
+    m_vertexData = m_vertexFormat.pack(vertices, m_boundsMin, m_boundsMax,
+                                       m_hasTexCoords);
+  }
+  else
+  {
+    m_vertexFormat = VertexFormat{};
+    const auto *bytes{reinterpret_cast<const std::byte *>(vertices.data())};
+    m_vertexData.assign(bytes, bytes + sizeof(vertices[0]) * vertices.size());
+  }
+}
 
-  tinyobj::ObjReader reader;
+void Testarossa::readParts(const ObjData &obj)
+{
+  // Colors for parts without a material
+  static const std::array partPalette{
+      glm::vec4{0.7f, 0.1f, 0.1f, 1.0f}, // 4 Vermelho
+      glm::vec4{0.9f, 0.9f, 0.7f, 1.0f}, // 1 Cinza
+      glm::vec4{0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
+      glm::vec4{0.9f, 0.9f, 0.7f, 1.0f}, // 1 Cinza
+      glm::vec4{1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
+      glm::vec4{0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
+      glm::vec4{0.9f, 0.9f, 0.7f, 1.0f}, // 1 Cinza
+      glm::vec4{0.7f, 0.1f, 0.1f, 1.0f}, // 4 Vermelho
+      glm::vec4{0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
+      glm::vec4{1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
+      glm::vec4{0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
+      glm::vec4{1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
+      glm::vec4{0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
+      glm::vec4{1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
+      glm::vec4{0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
+      glm::vec4{1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
+  };
 
-  if (!reader.ParseFromFile(path.data(), readerConfig))
+  m_parts.clear();
+  m_ranges.clear();
+  for (const auto &submesh : obj.submeshes)
   {
-    if (!reader.Error().empty())
+    auto &part{m_parts.emplace_back()};
+    part.name = submesh.name;
+    part.color = partPalette.at((m_parts.size() - 1) % partPalette.size());
+    if (submesh.materialIndex >= 0)
     {
-      throw abcg::Exception{abcg::Exception::Runtime(
-          fmt::format("Failed to load model {} ({})", path, reader.Error()))};
+      const auto &material{obj.materials.at(submesh.materialIndex)};
+      part.color = glm::vec4{material.diffuse, 1.0f};
     }
-    throw abcg::Exception{
-        abcg::Exception::Runtime(fmt::format("Failed to load model {}", path))};
+    m_ranges.push_back({submesh.firstIndex, submesh.indexCount});
   }
 
-  if (!reader.Warning().empty())
+  if (m_parts.empty())
+  {
+    m_parts.emplace_back().color = partPalette.at(0);
+    m_ranges.push_back({0, m_indices.size()});
+  }
+}
+
+void Testarossa::separateParts()
+{
+  // Welding joins parts along their seams; give each part its own copy of
+  // the vertices it shares, so that every vertex belongs to a single part
+  const auto partCount{m_ranges.size() / m_lodCount};
+  constexpr auto unassigned{std::numeric_limits<std::size_t>::max()};
+  std::vector<std::size_t> vertexParts(m_vertices.size(), unassigned);
+  std::unordered_map<std::uint64_t, GLuint> copies;
+  for (const auto rangeIndex : iter::range(m_ranges.size()))
+  {
+    const auto &range{m_ranges.at(rangeIndex)};
+    const auto part{rangeIndex % partCount};
+    for (const auto i : iter::range(range.first, range.first + range.count))
+    {
+      auto &index{m_indices.at(i)};
+      if (vertexParts.at(index) == unassigned)
+        vertexParts.at(index) = part;
+      if (vertexParts.at(index) == part)
+        continue;
+
+      const auto key{(std::uint64_t{index} << 32) | part};
+      const auto [copy, isNew]{
+          copies.try_emplace(key, static_cast<GLuint>(m_vertices.size()))};
+      if (isNew)
+      {
+        const auto vertex{m_vertices.at(index)};
+        m_vertices.push_back(vertex);
+        vertexParts.push_back(part);
+      }
+      index = copy->second;
+    }
+  }
+}
+
+void Testarossa::readObj(std::string_view path, bool standardize,
+                         bool packVertices)
+{
+  abcg::ElapsedTimer timer;
+  m_packVertices = packVertices;
+
+  // Use properties of first material, if available
+  m_Ka = {0.5f, 0.5f, 0.5f, 1.0f};
+  m_Kd = {0.5f, 0.5f, 0.5f, 1.0f};
+  m_Ks = {0.5f, 0.5f, 0.5f, 1.0f};
+  m_shininess = 2.5f;
+
+  // Try the binary cache first
+  const MeshCacheKey cacheKey{
+      MeshCache::hashObj(path),
+      standardize ? MeshCacheKey::standardized : 0u, sizeof(Vertex)};
+  const auto cachePath{MeshCache::cachePath(path)};
+  if (MeshCache cache; cache.open(cachePath, cacheKey))
   {
-    fmt::print("Warning: {}\n", reader.Warning());
+    cache.copyTo(m_vertices, m_indices);
+    m_lodCount = cache.info().lodCount;
+    m_ranges.clear();
+    GLuint previous{};
+    for (const auto end : cache.info().rangeEnds)
+    {
+      m_ranges.push_back({previous, end - previous});
+      previous = end;
+    }
+    if (m_ranges.empty())
+      m_ranges.push_back({0, m_indices.size()});
+    m_parts = cache.info().parts;
+    m_hasNormals = cache.info().hasNormals;
+    m_hasTexCoords = cache.info().hasTexCoords;
+    m_boundsMin = cache.info().boundsMin;
+    m_boundsMax = cache.info().boundsMax;
+    m_partVisible.assign(m_parts.size(), true);
+    prepareBuffers();
+    fmt::print("{}: loaded from cache in {:.2f} ms\n", path,
+               timer.elapsed() * 1000.0);
+    return;
   }
 
-  const auto &attrib{reader.GetAttrib()};
-  const auto &shapes{reader.GetShapes()};
+  const auto obj{parseObj(path)};
 
   m_vertices.clear();
   m_indices.clear();
@@ -210,61 +318,52 @@ void Testarossa::loadObj(std::string_view path, bool standardize)
   m_hasNormals = false;
   m_hasTexCoords = false;
 
-  // A key:value map with key=Vertex and value=index
-  std::unordered_map<Vertex, GLuint> hash{};
+  // Welds corners that share position and normal
+  abcg::ElapsedTimer weldTimer;
+  VertexWelder<6> welder{obj.indices.size()};
+  m_indices.reserve(obj.indices.size());
 
-  // Loop over shapes
-  for (const auto &shape : shapes)
+  // Loop over triangle corners
+  for (const auto &index : obj.indices)
   {
-    // Loop over indices
-    for (const auto offset : iter::range(shape.mesh.indices.size()))
+    // Vertex position
+    const int startIndex{3 * index.vertex};
+    const float vx{obj.positions.at(startIndex + 0)};
+    const float vy{obj.positions.at(startIndex + 1)};
+    const float vz{obj.positions.at(startIndex + 2)};
+
+    // Vertex normal
+    float nx{};
+    float ny{};
+    float nz{};
+    if (index.normal >= 0)
     {
-      // Access to vertex
-      const tinyobj::index_t index{shape.mesh.indices.at(offset)};
-
-      // Vertex position
-      const int startIndex{3 * index.vertex_index};
-      const float vx{attrib.vertices.at(startIndex + 0)};
-      const float vy{attrib.vertices.at(startIndex + 1)};
-      const float vz{attrib.vertices.at(startIndex + 2)};
-
-      // Vertex normal
-      float nx{};
-      float ny{};
-      float nz{};
-      if (index.normal_index >= 0)
-      {
-        m_hasNormals = true;
-        const int normalStartIndex{3 * index.normal_index};
-        nx = attrib.normals.at(normalStartIndex + 0);
-        ny = attrib.normals.at(normalStartIndex + 1);
-        nz = attrib.normals.at(normalStartIndex + 2);
-      }
+      m_hasNormals = true;
+      const int normalStartIndex{3 * index.normal};
+      nx = obj.normals.at(normalStartIndex + 0);
+      ny = obj.normals.at(normalStartIndex + 1);
+      nz = obj.normals.at(normalStartIndex + 2);
+    }
 
-      Vertex vertex{};
-      vertex.position = {vx, vy, vz};
-      vertex.normal = {nx, ny, nz};
-      // vertex.texCoord = {tu, tv};
+    Vertex vertex{};
+    vertex.position = {vx, vy, vz};
+    vertex.normal = {nx, ny, nz};
+    // vertex.texCoord = {tu, tv};
 
-      // If hash doesn't contain this vertex
-      if (hash.count(vertex) == 0)
-      {
-        // Add this index (size of m_vertices)
-        hash[vertex] = m_vertices.size();
-        // Add this vertex
-        m_vertices.push_back(vertex);
-      }
-
-      m_indices.push_back(hash[vertex]);
+    const auto [vertexIndex, isNew]{
+        welder.insert(welder.makeKey({vx, vy, vz, nx, ny, nz}))};
+    if (isNew)
+    {
+      // Add this vertex
+      m_vertices.push_back(vertex);
     }
-  }
 
-  // Use properties of first material, if available
-  m_Ka = {0.5f, 0.5f, 0.5f, 1.0f};
-  m_Kd = {0.5f, 0.5f, 0.5f, 1.0f};
-  m_Ks = {0.5f, 0.5f, 0.5f, 1.0f};
-  m_shininess = 2.5f;
+    m_indices.push_back(vertexIndex);
+  }
+  const auto weldTime{weldTimer.elapsed()};
 
+  // Vertex attribute kernels, timed to compare instruction sets
+  abcg::ElapsedTimer attributeTimer;
   if (standardize)
   {
     this->standardize();
@@ -279,123 +378,126 @@ void Testarossa::loadObj(std::string_view path, bool standardize)
   {
     computeTangents();
   }
+  const auto attributeTime{attributeTimer.elapsed()};
 
-  createBuffers();
+  // Parts at full detail, then the same parts at each coarser level
+  readParts(obj);
+  computePartBounds();
+  m_partVisible.assign(m_parts.size(), true);
+  m_lodCount = lodLevels;
+  {
+    std::vector<glm::vec3> positions;
+    positions.reserve(m_vertices.size());
+    for (const auto &vertex : m_vertices)
+      positions.push_back(vertex.position);
+    generateLods(positions, m_indices, m_ranges, m_lodCount);
+  }
+  separateParts();
+
+  // Reorder within each range so the draw calls of render() keep their ranges
+  optimizeMesh(path, m_vertices, m_indices, m_ranges);
+
+  computeBounds();
+
+  MeshCacheInfo cacheInfo;
+  cacheInfo.hasNormals = m_hasNormals;
+  cacheInfo.hasTexCoords = m_hasTexCoords;
+  cacheInfo.boundsMin = m_boundsMin;
+  cacheInfo.boundsMax = m_boundsMax;
+  cacheInfo.Ka = m_Ka;
+  cacheInfo.Kd = m_Kd;
+  cacheInfo.Ks = m_Ks;
+  cacheInfo.shininess = m_shininess;
+  cacheInfo.lodCount = static_cast<std::uint32_t>(m_lodCount);
+  for (const auto &range : m_ranges)
+    cacheInfo.rangeEnds.push_back(
+        static_cast<GLuint>(range.first + range.count));
+  cacheInfo.parts = m_parts;
+  MeshCache::save(cachePath, cacheKey, m_vertices, m_indices, cacheInfo);
+
+  prepareBuffers();
+  fmt::print("{}: parsed in {:.2f} ms (welding {:.2f} ms, attributes "
+             "{:.2f} ms with {})\n",
+             path, timer.elapsed() * 1000.0, weldTime * 1000.0,
+             attributeTime * 1000.0, meshKernelsName());
 }
 
-void Testarossa::paintGL(GLuint m_program, glm::mat4 &viewMatrix, glm::mat4 &projMatrix, glm::mat4 &kartMatrix, GLfloat &lightDir, GLfloat &Ia, GLfloat &Id, GLfloat &Is)
+void Testarossa::paintGL(Program &program, UniformStream &uniforms,
+                         const glm::mat4 &viewMatrix,
+                         const glm::mat4 &projMatrix,
+                         const glm::mat4 &kartMatrix)
 {
-  glUseProgram(m_program);
-
-  // Get location of uniform variables (could be precomputed)
-  GLint viewMatrixLoc{glGetUniformLocation(m_program, "viewMatrix")};
-  GLint projMatrixLoc{glGetUniformLocation(m_program, "projMatrix")};
-  GLint modelMatrixLoc{glGetUniformLocation(m_program, "modelMatrix")};
-  GLint normalMatrixLoc{glGetUniformLocation(m_program, "normalMatrix")};
-  GLint lightDirLoc{glGetUniformLocation(m_program, "lightDirWorldSpace")};
-  GLint shininessLoc{glGetUniformLocation(m_program, "shininess")};
-  GLint IaLoc{glGetUniformLocation(m_program, "Ia")};
-  GLint IdLoc{glGetUniformLocation(m_program, "Id")};
-  GLint IsLoc{glGetUniformLocation(m_program, "Is")};
-  GLint KaLoc{glGetUniformLocation(m_program, "Ka")};
-  GLint KdLoc{glGetUniformLocation(m_program, "Kd")};
-  GLint KsLoc{glGetUniformLocation(m_program, "Ks")};
-  GLint diffuseTexLoc{glGetUniformLocation(m_program, "diffuseTex")};
-  GLint mappingModeLoc{glGetUniformLocation(m_program, "mappingMode")};
-
-  glUniform4fv(lightDirLoc, 1, &lightDir);
-  glUniform4fv(IaLoc, 1, &Ia);
-  glUniform4fv(IdLoc, 1, &Id);
-  glUniform4fv(IsLoc, 1, &Is);
-  glUniform1i(diffuseTexLoc, 0);
-
-  glUniformMatrix4fv(viewMatrixLoc, 1, GL_FALSE, &viewMatrix[0][0]);
-  glUniformMatrix4fv(projMatrixLoc, 1, GL_FALSE, &projMatrix[0][0]);
+  program.use();
+  program.set(program.uniform("diffuseTex"), 0);
+  m_vertexFormat.setUniforms(program);
 
   // treno
-  glUniformMatrix4fv(modelMatrixLoc, 1, GL_FALSE, &kartMatrix[0][0]);
-
-  auto modelViewMatrix{glm::mat3(viewMatrix * kartMatrix)};
-  glm::mat3 normalMatrix{glm::inverseTranspose(modelViewMatrix)};
-  glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, &normalMatrix[0][0]);
-
-  //modelWall
-  glm::vec4 Ka = getKa();
-  glm::vec4 Kd = getKa();
-  glm::vec4 Ks = getKa();
-
-  glUniform1f(shininessLoc, getShininess());
-  glUniform4fv(KaLoc, 1, &Ka.x);
-  glUniform4fv(KdLoc, 1, &Kd.x);
-  glUniform4fv(KsLoc, 1, &Ks.x);
-
-  glUniform1i(mappingModeLoc, 3); // From hash
-
-  render(KaLoc, KdLoc, KsLoc);
+  DrawUniforms draw;
+  draw.modelMatrix = kartMatrix;
+  draw.normalMatrix =
+      glm::mat4{glm::inverseTranspose(glm::mat3(viewMatrix * kartMatrix))};
+
+  // The part colors scale the material
+  draw.Ka = glm::vec4{1.0f};
+  draw.Kd = glm::vec4{1.0f};
+  draw.Ks = glm::vec4{1.0f};
+  draw.shininess = getShininess();
+  draw.partColored = 1;
+  uniforms.push(drawUniformsBinding, draw);
+
+  cullParts(projMatrix * viewMatrix * kartMatrix);
+  render(selectLod(kartMatrix, viewMatrix, projMatrix));
 }
-
-void Testarossa::render(GLint KaLoc, GLint KdLoc, GLint KsLoc) const
+void Testarossa::render(std::size_t lod) const
 {
-  abcg::glBindVertexArray(m_VAO);
-  // std::vector<glm::vec4> colorList = {
-  //     {1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
-  //     {0.9f, 0.9f, 0.7f, 1.0f}, // 1 Cinza
-  //     {0.8f, 0.9f, 0.4f, 1.0f}, // 2 Limão
-  //     {0.7f, 0.4f, 0.4f, 1.0f}, // 3 Tamarindo
-  //     {0.7f, 0.1f, 0.1f, 1.0f}, // 4 Vermelho
-  //     {0.5f, 0.4f, 0.7f, 1.0f}, // 5 Roxo
-  //     {0.4f, 0.8f, 0.4f, 1.0f}, // 6 Ciano
-  //     {0.1f, 0.1f, 0.7f, 1.0f}, // 7 Azul
-  //     {0.0f, 0.4f, 0.1f, 1.0f}, // 8 Verde
-  //     {0.3f, 0.3f, 0.3f, 1.0f}  // 9 Preto
-  // };
-  // std::vector<uint8_t> sequencia{
-  //   4, 1, 9, 1, 0, 9, 1, 4, 9, 0, 9, 0, 9, 0, 9, 0
-  // };
-
-  const std::vector<glm::vec4> KList = {
-      {0.7f, 0.1f, 0.1f, 1.0f}, // 4 Vermelho
-      {0.9f, 0.9f, 0.7f, 1.0f}, // 1 Cinza
-      {0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
-      {0.9f, 0.9f, 0.7f, 1.0f}, // 1 Cinza
-      {1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
-      {0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
-      {0.9f, 0.9f, 0.7f, 1.0f}, // 1 Cinza
-      {0.7f, 0.1f, 0.1f, 1.0f}, // 4 Vermelho
-      {0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
-      {1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
-      {0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
-      {1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
-      {0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
-      {1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
-      {0.3f, 0.3f, 0.3f, 1.0f}, // 9 Preto
-      {1.0f, 0.9f, 0.4f, 1.0f}, // 0 Amarelo
-  };
-
-  abcg::glUniform4fv(KaLoc, 1, &KList.at(0).x);
-  abcg::glUniform4fv(KdLoc, 1, &KList.at(0).x);
-  abcg::glUniform4fv(KsLoc, 1, &KList.at(0).x);
-  glDrawElements(GL_TRIANGLES, m_fim_chassis, GL_UNSIGNED_INT, nullptr);
+  abcg::glBindBufferBase(GL_UNIFORM_BUFFER, partColorsBinding,
+                         m_partColorsUBO);
+  if (!shaderDefines().empty())
+  {
+    glstate::bindTexture(0, GL_TEXTURE_2D, m_diffuseTexture);
+    glstate::bindSampler(0, samplers::get(Sampler::LinearMipRepeat));
+  }
 
-  // Continuação da sequência
-  for (long unsigned int index = 1; index < m_sequencia_objetos.size(); index++)
+  // Visible parts at this level of detail
+  const auto partCount{m_ranges.size() / m_lodCount};
+  m_drawRanges.clear();
+  for (const auto part : iter::range(std::min(partCount, m_parts.size())))
   {
-    abcg::glUniform4fv(KaLoc, 1, &KList.at(index).x);
-    abcg::glUniform4fv(KdLoc, 1, &KList.at(index).x);
-    abcg::glUniform4fv(KsLoc, 1, &KList.at(index).x);
-    drawBody(m_sequencia_objetos[index], m_sequencia_objetos[index - 1]);
+    if (part >= m_partVisible.size() || m_partVisible.at(part))
+      m_drawRanges.push_back(std::min(lod, m_lodCount - 1) * partCount + part);
   }
 
-  abcg::glBindVertexArray(0);
+  glstate::bindVertexArray(m_VAO);
+  m_indexLayout.draw(m_drawRanges);
 }
 
-void Testarossa::drawBody(int proximo, int anterior) const
+std::size_t Testarossa::selectLod(const glm::mat4 &modelMatrix,
+                                  const glm::mat4 &viewMatrix,
+                                  const glm::mat4 &projMatrix) const
 {
-  const auto m_vertices_ToDraw = proximo - anterior;
-  glDrawElements(GL_TRIANGLES, m_vertices_ToDraw, GL_UNSIGNED_INT, (void *)(anterior * sizeof(GLuint)));
+  // Bounding sphere in view space
+  const auto modelViewMatrix{viewMatrix * modelMatrix};
+  const auto center{glm::vec3(
+      modelViewMatrix * glm::vec4((m_boundsMin + m_boundsMax) / 2.0f, 1.0f))};
+  const auto radius{glm::length(glm::vec3(
+      modelViewMatrix * glm::vec4((m_boundsMax - m_boundsMin) / 2.0f, 0.0f)))};
+
+  // Projected diameter as a fraction of the viewport height
+  const auto distance{std::max(-center.z, radius)};
+  const auto screenSize{radius * projMatrix[1][1] / distance};
+
+  // Every level has half the triangles of the previous one
+  std::size_t lod{};
+  auto threshold{lodScreenSize};
+  while (lod + 1 < m_lodCount && screenSize < threshold)
+  {
+    ++lod;
+    threshold /= 2.0f;
+  }
+  return lod;
 }
 
-void Testarossa::setupVAO(GLuint program)
+void Testarossa::setupVAO(const Program &program)
 {
   // Release previous VAO
   abcg::glDeleteVertexArrays(1, &m_VAO);
@@ -409,45 +511,59 @@ void Testarossa::setupVAO(GLuint program)
   abcg::glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
 
   // Bind vertex attributes
-  const GLint positionAttribute{
-      abcg::glGetAttribLocation(program, "inPosition")};
-  if (positionAttribute >= 0)
+  if (m_vertexFormat.isPacked())
   {
-    abcg::glEnableVertexAttribArray(positionAttribute);
-    abcg::glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE,
-                                sizeof(Vertex), nullptr);
+    m_vertexFormat.setupAttributes(program);
   }
-
-  const GLint normalAttribute{abcg::glGetAttribLocation(program, "inNormal")};
-  if (normalAttribute >= 0)
+  else
   {
-    abcg::glEnableVertexAttribArray(normalAttribute);
-    GLsizei offset{sizeof(glm::vec3)};
-    abcg::glVertexAttribPointer(normalAttribute, 3, GL_FLOAT, GL_FALSE,
-                                sizeof(Vertex),
-                                reinterpret_cast<void *>(offset));
-  }
+    const GLint positionAttribute{program.attribute("inPosition")};
+    if (positionAttribute >= 0)
+    {
+      abcg::glEnableVertexAttribArray(positionAttribute);
+      abcg::glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE,
+                                  sizeof(Vertex), nullptr);
+    }
 
-  const GLint texCoordAttribute{
-      abcg::glGetAttribLocation(program, "inTexCoord")};
-  if (texCoordAttribute >= 0)
-  {
-    abcg::glEnableVertexAttribArray(texCoordAttribute);
-    GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3)};
-    abcg::glVertexAttribPointer(texCoordAttribute, 2, GL_FLOAT, GL_FALSE,
-                                sizeof(Vertex),
-                                reinterpret_cast<void *>(offset));
+    const GLint normalAttribute{program.attribute("inNormal")};
+    if (normalAttribute >= 0)
+    {
+      abcg::glEnableVertexAttribArray(normalAttribute);
+      GLsizei offset{sizeof(glm::vec3)};
+      abcg::glVertexAttribPointer(normalAttribute, 3, GL_FLOAT, GL_FALSE,
+                                  sizeof(Vertex),
+                                  reinterpret_cast<void *>(offset));
+    }
+
+    const GLint texCoordAttribute{program.attribute("inTexCoord")};
+    if (texCoordAttribute >= 0)
+    {
+      abcg::glEnableVertexAttribArray(texCoordAttribute);
+      GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3)};
+      abcg::glVertexAttribPointer(texCoordAttribute, 2, GL_FLOAT, GL_FALSE,
+                                  sizeof(Vertex),
+                                  reinterpret_cast<void *>(offset));
+    }
+
+    const GLint tangentCoordAttribute{program.attribute("inTangent")};
+    if (tangentCoordAttribute >= 0)
+    {
+      abcg::glEnableVertexAttribArray(tangentCoordAttribute);
+      GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3) +
+                     sizeof(glm::vec2)};
+      abcg::glVertexAttribPointer(tangentCoordAttribute, 4, GL_FLOAT, GL_FALSE,
+                                  sizeof(Vertex),
+                                  reinterpret_cast<void *>(offset));
+    }
   }
 
-  const GLint tangentCoordAttribute{
-      abcg::glGetAttribLocation(program, "inTangent")};
-  if (tangentCoordAttribute >= 0)
+  const GLint partAttribute{program.attribute("inPart")};
+  if (partAttribute >= 0)
   {
-    abcg::glEnableVertexAttribArray(tangentCoordAttribute);
-    GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec2)};
-    abcg::glVertexAttribPointer(tangentCoordAttribute, 4, GL_FLOAT, GL_FALSE,
-                                sizeof(Vertex),
-                                reinterpret_cast<void *>(offset));
+    abcg::glBindBuffer(GL_ARRAY_BUFFER, m_partVBO);
+    abcg::glEnableVertexAttribArray(partAttribute);
+    abcg::glVertexAttribPointer(partAttribute, 1, GL_UNSIGNED_BYTE, GL_FALSE,
+                                sizeof(std::uint8_t), nullptr);
   }
 
   // End of binding
@@ -458,27 +574,7 @@ void Testarossa::setupVAO(GLuint program)
 void Testarossa::standardize()
 {
   // Center to origin and normalize largest bound to [-1, 1]
-
-  // Get bounds
-  glm::vec3 max(std::numeric_limits<float>::lowest());
-  glm::vec3 min(std::numeric_limits<float>::max());
-  for (const auto &vertex : m_vertices)
-  {
-    max.x = std::max(max.x, vertex.position.x);
-    max.y = std::max(max.y, vertex.position.y);
-    max.z = std::max(max.z, vertex.position.z);
-    min.x = std::min(min.x, vertex.position.x);
-    min.y = std::min(min.y, vertex.position.y);
-    min.z = std::min(min.z, vertex.position.z);
-  }
-
-  // Center and scale
-  const auto center{(min + max) / 2.0f};
-  const auto scaling{2.0f / glm::length(max - min)};
-  for (auto &vertex : m_vertices)
-  {
-    vertex.position = (vertex.position - center) * scaling;
-  }
+  ::standardize(m_vertices);
 }
 
 void Testarossa::terminateGL()
@@ -487,6 +583,10 @@ void Testarossa::terminateGL()
   abcg::glDeleteTextures(1, &m_normalTexture);
   abcg::glDeleteTextures(1, &m_diffuseTexture);
   abcg::glDeleteBuffers(1, &m_EBO);
+  abcg::glDeleteBuffers(1, &m_partVBO);
+  abcg::glDeleteBuffers(1, &m_partColorsUBO);
   abcg::glDeleteBuffers(1, &m_VBO);
   abcg::glDeleteVertexArrays(1, &m_VAO);
-}
\ No newline at end of file
+}
+
+void Testarossa::uploadGL() { createBuffers(); }
@@ -1,25 +1,65 @@
 #ifndef TESTAROSSA_HPP_
 #define TESTAROSSA_HPP_
 
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
 #include "abcg.hpp"
 #include "labirinto.hpp"
+#include "meshcache.hpp"
+#include "meshlets.hpp"
+#include "objparser.hpp"
+#include "program.hpp"
+#include "shadervariants.hpp"
+#include "uniformstream.hpp"
+#include "vertexformat.hpp"
 
 class Testarossa {
  public:
+  // Shader variant for this material: the car has no texture coordinates,
+  // so it is normally drawn untextured
+  [[nodiscard]] std::string_view shaderDefines() const {
+    return m_hasTexCoords && m_diffuseTexture != 0 ? shaderdefines::diffuseMap
+                                                   : std::string_view{};
+  }
+
   void loadCubeTexture(const std::string& path);
   void loadDiffuseTexture(std::string_view path);
   void loadNormalTexture(std::string_view path);
-  void loadObj(std::string_view path, bool standardize = true);
-  void render(GLint KaLoc, GLint KdLoc, GLint KsLoc) const;
-  void setupVAO(GLuint program);
+  void loadObj(std::string_view path, bool standardize = true,
+               bool packVertices = false);
+
+  // loadObj in two steps: readObj only touches memory and may run on a
+  // worker thread; uploadGL then creates the buffers on the GL thread
+  void readObj(std::string_view path, bool standardize = true,
+               bool packVertices = false);
+  void uploadGL();
+
+  // Draws every visible part in one call, coloring them in the shaders.
+  // Expects DrawUniforms with partColored set to be bound.
+  void render(std::size_t lod = 0) const;
+  void setupVAO(const Program& program);
   void terminateGL();
-  void drawBody(int proximo, int anterior) const;
-  void paintGL(GLuint m_program, glm::mat4 &viewMatrix, glm::mat4 &projMatrix, glm::mat4 &kartMatrix, GLfloat &lightDir, GLfloat &Ia, GLfloat &Id, GLfloat &Is);
 
+  // Hides from render() the parts whose bounds fall outside the view volume
+  // of clipMatrix (projection * view * model)
+  void cullParts(const glm::mat4 &clipMatrix);
+
+  // Level of detail for the projected size of the car
+  [[nodiscard]] std::size_t selectLod(const glm::mat4 &modelMatrix,
+                                      const glm::mat4 &viewMatrix,
+                                      const glm::mat4 &projMatrix) const;
+  // Expects the FrameUniforms of this frame to be bound
+  void paintGL(Program& program, UniformStream& uniforms,
+               const glm::mat4& viewMatrix, const glm::mat4& projMatrix,
+               const glm::mat4& kartMatrix);
+
+  // Triangles at full detail
   [[nodiscard]] int getNumTriangles() const {
-    return static_cast<int>(m_indices.size()) / 3;
+    const auto &last{m_ranges.at(m_ranges.size() / m_lodCount - 1)};
+    return static_cast<int>(last.first + last.count) / 3;
   }
 
   [[nodiscard]] glm::vec4 getKa() const { return m_Ka; }
@@ -35,6 +75,8 @@ class Testarossa {
   GLuint m_VAO{};
   GLuint m_VBO{};
   GLuint m_EBO{};
+  GLuint m_partVBO{};
+  GLuint m_partColorsUBO{}; // PartColors, uploaded with the mesh
 
   glm::vec4 m_Ka{0.0f, 0.0f, 0.0f, 1.0f};
   glm::vec4 m_Kd{0.0f, 0.0f, 0.0f, 1.0f};
@@ -48,30 +90,43 @@ class Testarossa {
   std::vector<Vertex> m_vertices;
   std::vector<GLuint> m_indices;
 
+  // Layout of the uploaded vertices
+  bool m_packVertices{false};
+  VertexFormat m_vertexFormat;
+  IndexLayout m_indexLayout;
+  std::vector<std::byte> m_vertexData; // Read but not yet uploaded
+
+  // Ranges of the parts, level of detail after level of detail
+  static constexpr std::size_t lodLevels{4};
+  static constexpr float lodScreenSize{0.5f}; // Below it, drop to level 1
+  std::vector<IndexRange> m_ranges{{0, 0}};
+  std::size_t m_lodCount{1};
+
+  // One per submesh of the OBJ file, in the order of the ranges
+  std::vector<MeshPart> m_parts;
+  std::vector<bool> m_partVisible;
+
+  // Every vertex carries the index of its part, which the shaders use to
+  // fetch its color, so that parts need no uniforms of their own
+  static constexpr std::size_t maxPartColors{PartColors::maxParts};
+  std::vector<std::uint8_t> m_partData; // Read but not yet uploaded
+  mutable std::vector<std::size_t> m_drawRanges;
+
+  glm::vec3 m_boundsMin{};
+  glm::vec3 m_boundsMax{};
+
   bool m_hasNormals{false};
   bool m_hasTexCoords{false};
 
+  void computeBounds();
   void computeNormals();
+  void computePartBounds();
   void computeTangents();
   void createBuffers();
+  void prepareBuffers();
+  void readParts(const ObjData &obj);
+  void separateParts();
   void standardize();
-
-  // Valores obtidos usando o script testarossa.py
-  const int m_fim_chassis = 63705;
-  const int m_fim_limpadores = 67569;
-  const int m_fim_black = 67809;
-  const int m_fim_lanterna_di = 70041;
-  const int m_fim_interior = 159519;
-  const int m_fim_grelhas = 175824;
-  const int m_fim_vidros = 178392;
-  const int m_fim_lanterna_tr = 178758;
-  const int m_fim_pneu[4] = {190104, 219672, 249240, 278808};
-  const int m_fim_roda[4] = {208326, 237894, 267462, 297030};
-
-  const std::vector<int> m_sequencia_objetos = {
-    m_fim_chassis, m_fim_limpadores, m_fim_black, m_fim_lanterna_di, m_fim_interior,
-    m_fim_grelhas, m_fim_vidros, m_fim_lanterna_tr, m_fim_pneu[0], m_fim_roda[0],
-    m_fim_pneu[1], m_fim_roda[1], m_fim_pneu[2], m_fim_roda[2], m_fim_pneu[3], m_fim_roda[3]};
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "texturedata.hpp"
+
+#include <SDL_image.h>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace
+{
+#if !defined(__EMSCRIPTEN__)
+bool queryTextureStorage()
+{
+  GLint major{};
+  GLint minor{};
+  abcg::glGetIntegerv(GL_MAJOR_VERSION, &major);
+  abcg::glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major > 4 || (major == 4 && minor >= 2))
+    return true;
+
+  GLint count{};
+  abcg::glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint index{}; index < count; ++index)
+  {
+    const auto *extension{reinterpret_cast<const char *>(
+        abcg::glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(index)))};
+    if (extension != nullptr &&
+        std::strcmp(extension, "GL_ARB_texture_storage") == 0)
+      return true;
+  }
+  return false;
+}
+#endif
+
+// glTexStorage2D is core in OpenGL 4.2 and ES 3.0 (WebGL 2); a 4.1 context
+// needs ARB_texture_storage
+bool hasTextureStorage()
+{
+#if defined(__EMSCRIPTEN__)
+  return true;
+#else
+  static const bool supported{queryTextureStorage()};
+  return supported;
+#endif
+}
+} // namespace
+
+TextureData decodeTexture(std::string_view path)
+{
+  SDL_Surface *surface{IMG_Load(std::string{path}.c_str())};
+  if (surface == nullptr)
+  {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to load texture {}: {}", path, IMG_GetError()))};
+  }
+
+  SDL_Surface *rgba{
+      SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0)};
+  SDL_FreeSurface(surface);
+  if (rgba == nullptr)
+  {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to convert texture {}: {}", path, SDL_GetError()))};
+  }
+
+  TextureData data;
+  data.width = rgba->w;
+  data.height = rgba->h;
+  const auto rowSize{static_cast<std::size_t>(data.width) * 4};
+  data.pixels.resize(rowSize * static_cast<std::size_t>(data.height));
+
+  // Flip upside down
+  const auto *source{static_cast<const std::uint8_t *>(rgba->pixels)};
+  for (int row{}; row < data.height; ++row)
+  {
+    std::memcpy(data.pixels.data() +
+                    rowSize * static_cast<std::size_t>(data.height - 1 - row),
+                source + static_cast<std::ptrdiff_t>(rgba->pitch) * row,
+                rowSize);
+  }
+  SDL_FreeSurface(rgba);
+
+  return data;
+}
+
+GLuint createTexture(const TextureData &data)
+{
+  // Every level down to 1x1
+  GLsizei levels{1};
+  while ((std::max(data.width, data.height) >> levels) > 0)
+    ++levels;
+
+  GLuint texture{};
+  abcg::glGenTextures(1, &texture);
+  abcg::glBindTexture(GL_TEXTURE_2D, texture);
+  if (hasTextureStorage())
+  {
+    abcg::glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, data.width,
+                         data.height);
+  }
+  else
+  {
+    // Mutable storage with the same levels
+    for (GLint level{}; level < levels; ++level)
+    {
+      abcg::glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8,
+                         std::max(data.width >> level, 1),
+                         std::max(data.height >> level, 1), 0, GL_RGBA,
+                         GL_UNSIGNED_BYTE, nullptr);
+    }
+    abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  }
+  abcg::glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, data.width, data.height,
+                        GL_RGBA, GL_UNSIGNED_BYTE, data.pixels.data());
+  abcg::glGenerateMipmap(GL_TEXTURE_2D);
+  abcg::glBindTexture(GL_TEXTURE_2D, 0);
+  return texture;
+}
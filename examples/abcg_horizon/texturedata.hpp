@@ -0,0 +1,28 @@
+#ifndef TEXTUREDATA_HPP_
+#define TEXTUREDATA_HPP_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "abcg.hpp"
+
+// Decoded RGBA8 pixels, bottom row first like abcg::opengl::loadTexture
+struct TextureData
+{
+  int width{};
+  int height{};
+  std::vector<std::uint8_t> pixels;
+};
+
+// Decodes an image file without touching GL, so it can run on any thread.
+// Throws abcg::Exception on failure.
+[[nodiscard]] TextureData decodeTexture(std::string_view path);
+
+// Uploads decoded pixels to an RGBA8 texture with a full mip chain, immutable
+// where glTexStorage2D is available.
+// Filtering and wrapping come from the sampler it is drawn with (see
+// samplers.hpp). Must run on the GL thread.
+[[nodiscard]] GLuint createTexture(const TextureData &data);
+
+#endif
@@ -0,0 +1,46 @@
+#include "uniformstream.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+void UniformStream::initializeGL(GLsizeiptr capacity)
+{
+  GLint alignment{};
+  abcg::glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  m_alignment = std::max(alignment, 1);
+  m_capacity = capacity;
+
+  abcg::glGenBuffers(1, &m_buffer);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+  abcg::glBufferData(GL_UNIFORM_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformStream::terminateGL() { abcg::glDeleteBuffers(1, &m_buffer); }
+
+void UniformStream::begin()
+{
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+  abcg::glBufferData(GL_UNIFORM_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  m_offset = 0;
+}
+
+void UniformStream::push(GLuint binding, const void *data, GLsizeiptr size)
+{
+  if (m_offset + size > m_capacity)
+  {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Uniform stream full: {} of {} bytes used, {} more needed",
+                    m_offset, m_capacity, size))};
+  }
+
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+  abcg::glBufferSubData(GL_UNIFORM_BUFFER, m_offset, size, data);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  abcg::glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer, m_offset,
+                          size);
+
+  m_offset += (size + m_alignment - 1) / m_alignment * m_alignment;
+}
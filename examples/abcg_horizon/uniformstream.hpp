@@ -0,0 +1,76 @@
+#ifndef UNIFORMSTREAM_HPP_
+#define UNIFORMSTREAM_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "abcg.hpp"
+
+// Uniform blocks of the horizon shaders (std140), shared by every program
+struct FrameUniforms
+{
+  glm::mat4 viewMatrix{1.0f};
+  glm::mat4 projMatrix{1.0f};
+  glm::mat4 viewProjMatrix{1.0f};
+  glm::vec4 lightDirViewSpace{};
+  glm::vec4 Ia{};
+  glm::vec4 Id{};
+  glm::vec4 Is{};
+};
+
+struct DrawUniforms
+{
+  glm::mat4 modelMatrix{1.0f};
+  glm::mat4 normalMatrix{1.0f}; // mat3 in the upper left
+  glm::vec4 Ka{};
+  glm::vec4 Kd{};
+  glm::vec4 Ks{};
+  float shininess{};
+  std::uint32_t partColored{}; // Colors come from PartColors
+  float padding[2]{};
+};
+
+// Colors of the parts of a mesh, picked by the part of each vertex. Static,
+// uploaded once by the mesh that owns it.
+struct PartColors
+{
+  static constexpr std::size_t maxParts{64};
+
+  glm::vec4 colors[maxParts]{};
+};
+
+static_assert(sizeof(FrameUniforms) == 256);
+static_assert(sizeof(DrawUniforms) == 192);
+static_assert(sizeof(PartColors) == 1024);
+
+// Binding points of the blocks
+constexpr GLuint frameUniformsBinding{0};
+constexpr GLuint drawUniformsBinding{1};
+constexpr GLuint partColorsBinding{2};
+
+// One uniform buffer written front to back during a frame. begin() orphans
+// the storage of the last frame, so writing never waits for the GPU to finish
+// reading it, and each push() copies a block to the next offset allowed by
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and binds that range.
+class UniformStream
+{
+public:
+  void initializeGL(GLsizeiptr capacity);
+  void terminateGL();
+
+  void begin();
+  void push(GLuint binding, const void *data, GLsizeiptr size);
+
+  template <typename T> void push(GLuint binding, const T &block)
+  {
+    push(binding, &block, sizeof(T));
+  }
+
+private:
+  GLuint m_buffer{};
+  GLsizeiptr m_capacity{};
+  GLintptr m_alignment{1};
+  GLintptr m_offset{};
+};
+
+#endif
@@ -0,0 +1,406 @@
+#include "vertexcache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+  constexpr GLuint unused{std::numeric_limits<GLuint>::max()};
+
+  // Forsyth's scoring parameters
+  constexpr int maxCacheSize{32};
+  constexpr float cacheDecayPower{1.5f};
+  constexpr float lastTriangleScore{0.75f};
+  constexpr float valenceBoostScale{2.0f};
+  constexpr float valenceBoostPower{0.5f};
+
+  // Cache size assumed by the overdraw clustering
+  constexpr std::size_t overdrawCacheSize{16};
+
+  float vertexScore(int cachePosition, unsigned remaining)
+  {
+    // No triangle needs this vertex anymore
+    if (remaining == 0)
+      return -1.0f;
+
+    auto score{0.0f};
+    if (cachePosition >= 0)
+    {
+      if (cachePosition < 3)
+      {
+        // Used by the last triangle, so it is in the cache regardless
+        score = lastTriangleScore;
+      }
+      else
+      {
+        const auto scaler{1.0f / (maxCacheSize - 3)};
+        score = std::pow(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+      }
+    }
+
+    // Favor vertices with few triangles left, to get rid of lone triangles
+    score += valenceBoostScale *
+             std::pow(static_cast<float>(remaining), -valenceBoostPower);
+    return score;
+  }
+
+  // FIFO cache simulated with timestamps: a vertex is cached while fewer
+  // than cacheSize misses happened since it was loaded
+  class FifoCache
+  {
+  public:
+    FifoCache(std::size_t vertexCount, std::size_t cacheSize)
+        : m_loadTime(vertexCount, 0), m_cacheSize{cacheSize},
+          m_time{cacheSize + 1}
+    {
+    }
+
+    // Returns the number of misses of a triangle
+    unsigned access(const GLuint *triangle)
+    {
+      unsigned misses{};
+      for (auto i : {0, 1, 2})
+      {
+        auto &loadTime{m_loadTime[triangle[i]]};
+        if (m_time - loadTime > m_cacheSize)
+        {
+          loadTime = m_time++;
+          ++misses;
+        }
+      }
+      return misses;
+    }
+
+    void flush() { m_time += m_cacheSize + 1; }
+
+  private:
+    std::vector<std::size_t> m_loadTime;
+    std::size_t m_cacheSize;
+    std::size_t m_time;
+  };
+
+  void optimizeRange(GLuint *indices, std::size_t triangleCount,
+                     std::size_t vertexCount)
+  {
+    // Triangles adjacent to each vertex, in compressed rows. The first
+    // remaining[v] entries of a row are the triangles not yet emitted.
+    std::vector<unsigned> remaining(vertexCount, 0);
+    for (const auto i : iter::range(triangleCount * 3))
+      ++remaining[indices[i]];
+
+    std::vector<std::size_t> offsets(vertexCount + 1, 0);
+    std::partial_sum(remaining.begin(), remaining.end(), offsets.begin() + 1);
+
+    std::vector<std::size_t> adjacency(triangleCount * 3);
+    {
+      auto fill{offsets};
+      for (const auto i : iter::range(triangleCount * 3))
+        adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount, 0.0f);
+    for (const auto v : iter::range(vertexCount))
+      score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount, 0.0f);
+    std::vector<bool> emitted(triangleCount, false);
+    for (const auto t : iter::range(triangleCount))
+      for (auto i : {0, 1, 2})
+        triangleScore[t] += score[indices[t * 3 + i]];
+
+    std::vector<GLuint> output;
+    output.reserve(triangleCount * 3);
+
+    std::vector<GLuint> cache;
+    std::vector<GLuint> newCache;
+    cache.reserve(maxCacheSize + 3);
+    newCache.reserve(maxCacheSize + 3);
+
+    auto best{static_cast<std::size_t>(
+        std::max_element(triangleScore.begin(), triangleScore.end()) -
+        triangleScore.begin())};
+    std::size_t cursor{};
+
+    for (std::size_t emittedCount{}; emittedCount < triangleCount;
+         ++emittedCount)
+    {
+      const auto *triangle{indices + best * 3};
+      output.insert(output.end(), triangle, triangle + 3);
+      emitted[best] = true;
+
+      // Remove the triangle from the rows of its vertices
+      for (auto i : {0, 1, 2})
+      {
+        const auto v{triangle[i]};
+        const auto rowBegin{adjacency.begin() + offsets[v]};
+        const auto rowEnd{rowBegin + remaining[v]};
+        std::iter_swap(std::find(rowBegin, rowEnd, best), rowEnd - 1);
+        --remaining[v];
+      }
+
+      // Move the triangle vertices to the front of the LRU cache
+      newCache.assign(triangle, triangle + 3);
+      for (const auto v : cache)
+        if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+          newCache.push_back(v);
+      for (auto i{static_cast<std::size_t>(maxCacheSize)}; i < newCache.size();
+           ++i)
+        cachePosition[newCache[i]] = -1;
+      for (const auto i : iter::range(std::min<std::size_t>(newCache.size(),
+                                                            maxCacheSize)))
+        cachePosition[newCache[i]] = static_cast<int>(i);
+
+      // Propagate score changes to the triangles that are still pending
+      for (const auto v : newCache)
+      {
+        const auto newScore{vertexScore(cachePosition[v], remaining[v])};
+        const auto delta{newScore - score[v]};
+        score[v] = newScore;
+        for (const auto j : iter::range(remaining[v]))
+          triangleScore[adjacency[offsets[v] + j]] += delta;
+      }
+
+      if (newCache.size() > maxCacheSize)
+        newCache.resize(maxCacheSize);
+      std::swap(cache, newCache);
+
+      // Next triangle is the best one touching the cache
+      auto bestScore{-1.0f};
+      best = triangleCount;
+      for (const auto v : cache)
+      {
+        for (const auto j : iter::range(remaining[v]))
+        {
+          const auto t{adjacency[offsets[v] + j]};
+          if (triangleScore[t] > bestScore)
+          {
+            bestScore = triangleScore[t];
+            best = t;
+          }
+        }
+      }
+
+      // Otherwise restart from the first triangle not emitted yet
+      if (best == triangleCount)
+      {
+        while (cursor < triangleCount && emitted[cursor])
+          ++cursor;
+        best = cursor;
+      }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+  }
+
+  void sortClusters(GLuint *indices, std::size_t triangleCount,
+                    const std::vector<glm::vec3> &positions, float threshold)
+  {
+    if (triangleCount == 0)
+      return;
+
+    FifoCache cache{positions.size(), overdrawCacheSize};
+
+    // Hard boundaries: triangles that miss on all three vertices start over
+    // the cache anyway, so breaking there costs nothing
+    std::vector<std::size_t> hardClusters;
+    for (const auto t : iter::range(triangleCount))
+      if (cache.access(indices + t * 3) == 3)
+        hardClusters.push_back(t);
+    hardClusters.push_back(triangleCount);
+
+    // Soft boundaries: split a hard cluster once its running ACMR is within
+    // threshold of the ACMR of the whole hard cluster
+    std::vector<std::size_t> clusters;
+    for (const auto c : iter::range(hardClusters.size() - 1))
+    {
+      const auto begin{hardClusters[c]};
+      const auto end{hardClusters[c + 1]};
+
+      cache.flush();
+      unsigned clusterMisses{};
+      for (auto t{begin}; t < end; ++t)
+        clusterMisses += cache.access(indices + t * 3);
+      const auto clusterThreshold{threshold * static_cast<float>(clusterMisses) /
+                                  static_cast<float>(end - begin)};
+
+      cache.flush();
+      clusters.push_back(begin);
+      auto start{begin};
+      unsigned misses{};
+      for (auto t{begin}; t + 1 < end; ++t)
+      {
+        misses += cache.access(indices + t * 3);
+        if (static_cast<float>(misses) / static_cast<float>(t - start + 1) <=
+            clusterThreshold)
+        {
+          start = t + 1;
+          misses = 0;
+          clusters.push_back(start);
+          cache.flush();
+        }
+      }
+    }
+    clusters.push_back(triangleCount);
+
+    // Area-weighted centroid and normal of each cluster and of the range
+    const auto clusterCount{clusters.size() - 1};
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3{0.0f});
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3{0.0f});
+    std::vector<float> areas(clusterCount, 0.0f);
+    glm::vec3 meshCentroid{0.0f};
+    auto meshArea{0.0f};
+    for (const auto cluster : iter::range(clusterCount))
+    {
+      for (auto t{clusters[cluster]}; t < clusters[cluster + 1]; ++t)
+      {
+        const auto &a{positions[indices[t * 3 + 0]]};
+        const auto &b{positions[indices[t * 3 + 1]]};
+        const auto &c{positions[indices[t * 3 + 2]]};
+        const auto normal{glm::cross(b - a, c - a)};
+        const auto area{glm::length(normal)};
+        centroids[cluster] += (a + b + c) * (area / 3.0f);
+        normals[cluster] += normal;
+        areas[cluster] += area;
+      }
+      meshCentroid += centroids[cluster];
+      meshArea += areas[cluster];
+    }
+    if (meshArea > 0.0f)
+      meshCentroid /= meshArea;
+
+    // Clusters facing away from the center are drawn first, so they can
+    // occlude the rest
+    std::vector<float> sortKey(clusterCount, 0.0f);
+    for (const auto c : iter::range(clusterCount))
+    {
+      const auto length{glm::length(normals[c])};
+      if (areas[c] > 0.0f && length > 0.0f)
+        sortKey[c] = glm::dot(centroids[c] / areas[c] - meshCentroid,
+                              normals[c] / length);
+    }
+
+    std::vector<std::size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](auto lhs, auto rhs)
+                     { return sortKey[lhs] > sortKey[rhs]; });
+
+    std::vector<GLuint> output;
+    output.reserve(triangleCount * 3);
+    for (const auto c : order)
+      output.insert(output.end(), indices + clusters[c] * 3,
+                    indices + clusters[c + 1] * 3);
+    std::copy(output.begin(), output.end(), indices);
+  }
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const std::vector<GLuint> &indices,
+                                    const std::vector<IndexRange> &ranges,
+                                    std::size_t vertexCount,
+                                    std::size_t cacheSize)
+{
+  FifoCache cache{vertexCount, cacheSize};
+  std::vector<bool> referenced(vertexCount, false);
+  std::size_t misses{};
+  std::size_t triangles{};
+  std::size_t vertices{};
+
+  for (const auto &range : ranges)
+  {
+    cache.flush();
+    for (auto i{range.first}; i + 3 <= range.first + range.count; i += 3)
+    {
+      misses += cache.access(indices.data() + i);
+      ++triangles;
+      for (auto j : {0, 1, 2})
+      {
+        if (!referenced[indices[i + j]])
+        {
+          referenced[indices[i + j]] = true;
+          ++vertices;
+        }
+      }
+    }
+  }
+
+  VertexCacheStats stats;
+  if (triangles > 0)
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(triangles);
+  if (vertices > 0)
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(vertices);
+  return stats;
+}
+
+LocalIndices localizeIndices(const GLuint *indices, std::size_t count)
+{
+  LocalIndices local;
+  local.vertices.assign(indices, indices + count);
+  std::sort(local.vertices.begin(), local.vertices.end());
+  local.vertices.erase(
+      std::unique(local.vertices.begin(), local.vertices.end()),
+      local.vertices.end());
+
+  local.indices.resize(count);
+  for (const auto i : iter::range(count))
+    local.indices[i] = static_cast<GLuint>(
+        std::lower_bound(local.vertices.begin(), local.vertices.end(),
+                         indices[i]) -
+        local.vertices.begin());
+  return local;
+}
+
+void optimizeVertexCache(std::vector<GLuint> &indices,
+                         const std::vector<IndexRange> &ranges)
+{
+  for (const auto &range : ranges)
+  {
+    auto local{localizeIndices(indices.data() + range.first, range.count)};
+    optimizeRange(local.indices.data(), range.count / 3,
+                  local.vertices.size());
+    for (const auto i : iter::range(range.count))
+      indices[range.first + i] = local.vertices[local.indices[i]];
+  }
+}
+
+void optimizeOverdraw(std::vector<GLuint> &indices,
+                      const std::vector<IndexRange> &ranges,
+                      const std::vector<glm::vec3> &positions, float threshold)
+{
+  std::vector<glm::vec3> localPositions;
+  for (const auto &range : ranges)
+  {
+    auto local{localizeIndices(indices.data() + range.first, range.count)};
+    localPositions.clear();
+    for (const auto vertex : local.vertices)
+      localPositions.push_back(positions[vertex]);
+
+    sortClusters(local.indices.data(), range.count / 3, localPositions,
+                 threshold);
+    for (const auto i : iter::range(range.count))
+      indices[range.first + i] = local.vertices[local.indices[i]];
+  }
+}
+
+std::vector<GLuint> optimizeVertexFetch(std::vector<GLuint> &indices,
+                                        std::size_t vertexCount)
+{
+  std::vector<GLuint> newIndex(vertexCount, unused);
+  std::vector<GLuint> remap;
+  remap.reserve(vertexCount);
+
+  for (auto &index : indices)
+  {
+    if (newIndex[index] == unused)
+    {
+      newIndex[index] = static_cast<GLuint>(remap.size());
+      remap.push_back(index);
+    }
+    index = newIndex[index];
+  }
+
+  return remap;
+}
@@ -0,0 +1,97 @@
+#ifndef VERTEXCACHE_HPP_
+#define VERTEXCACHE_HPP_
+
+#include <fmt/core.h>
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "abcg.hpp"
+
+// Contiguous run of indices drawn by a single glDrawElements call
+struct IndexRange
+{
+  std::size_t first{};
+  std::size_t count{};
+};
+
+// Indices of a range renumbered from 0, keeping the order of the vertices,
+// so scratch arrays can be sized to the range rather than to the mesh
+struct LocalIndices
+{
+  std::vector<GLuint> indices;
+  std::vector<GLuint> vertices; // Mesh vertex of each local vertex
+};
+
+[[nodiscard]] LocalIndices localizeIndices(const GLuint *indices,
+                                           std::size_t count);
+
+// Post-transform cache efficiency of a triangle list, simulated with a FIFO
+// cache of cacheSize vertices that is flushed at the start of every range.
+// ACMR is misses per triangle (0.5 is ideal for large grids, 3 is worst) and
+// ATVR is misses per referenced vertex (1 is ideal).
+struct VertexCacheStats
+{
+  float acmr{};
+  float atvr{};
+};
+
+[[nodiscard]] VertexCacheStats
+analyzeVertexCache(const std::vector<GLuint> &indices,
+                   const std::vector<IndexRange> &ranges,
+                   std::size_t vertexCount, std::size_t cacheSize = 16);
+
+// Reorders the triangles of each range for post-transform cache locality
+// (Forsyth's linear-speed vertex cache optimization)
+void optimizeVertexCache(std::vector<GLuint> &indices,
+                         const std::vector<IndexRange> &ranges);
+
+// Splits each range into clusters that keep the cache order found above and
+// sorts them so outward-facing clusters are drawn first. threshold is the
+// ACMR increase a cluster may trade for a finer split (Tipsify).
+void optimizeOverdraw(std::vector<GLuint> &indices,
+                      const std::vector<IndexRange> &ranges,
+                      const std::vector<glm::vec3> &positions,
+                      float threshold = 1.05f);
+
+// Renumbers vertices in order of first use and rewrites indices to match.
+// Returns, for each new vertex, the old vertex it comes from. Unreferenced
+// vertices are dropped.
+[[nodiscard]] std::vector<GLuint>
+optimizeVertexFetch(std::vector<GLuint> &indices, std::size_t vertexCount);
+
+// Runs the three passes above on a mesh and reports ACMR/ATVR before and
+// after. V must have a glm::vec3 position member.
+template <typename V>
+void optimizeMesh(std::string_view name, std::vector<V> &vertices,
+                  std::vector<GLuint> &indices,
+                  const std::vector<IndexRange> &ranges)
+{
+  abcg::ElapsedTimer timer;
+  const auto before{analyzeVertexCache(indices, ranges, vertices.size())};
+
+  optimizeVertexCache(indices, ranges);
+
+  std::vector<glm::vec3> positions;
+  positions.reserve(vertices.size());
+  for (const auto &vertex : vertices)
+    positions.push_back(vertex.position);
+  optimizeOverdraw(indices, ranges, positions);
+
+  const auto remap{optimizeVertexFetch(indices, vertices.size())};
+  std::vector<V> reordered;
+  reordered.reserve(remap.size());
+  for (const auto oldIndex : remap)
+    reordered.push_back(vertices[oldIndex]);
+  vertices = std::move(reordered);
+
+  const auto after{analyzeVertexCache(indices, ranges, vertices.size())};
+  fmt::print("{}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f} "
+             "(optimized in {:.2f} ms)\n",
+             name, before.acmr, after.acmr, before.atvr, after.atvr,
+             timer.elapsed() * 1000.0);
+}
+
+#endif
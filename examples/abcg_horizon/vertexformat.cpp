@@ -0,0 +1,155 @@
+#include "vertexformat.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+  constexpr GLsizei positionOffset{0};
+  constexpr GLsizei normalOffset{8};
+  constexpr GLsizei texCoordOffset{12};
+
+  std::int16_t toSnorm16(float value)
+  {
+    return static_cast<std::int16_t>(
+        std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+  }
+
+  std::uint16_t toUnorm16(float value)
+  {
+    return static_cast<std::uint16_t>(
+        std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+  }
+
+  // Maps a unit vector to the octahedron and unfolds it onto [-1, 1]^2
+  std::array<std::int16_t, 2> encodeOctahedral(const glm::vec3 &direction)
+  {
+    const auto sum{std::abs(direction.x) + std::abs(direction.y) +
+                   std::abs(direction.z)};
+    if (!(sum > 0.0f))
+      return {0, 0}; // Degenerate; decodes to +z
+
+    auto x{direction.x / sum};
+    auto y{direction.y / sum};
+    if (direction.z < 0.0f)
+    {
+      const auto foldedX{(1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f)};
+      const auto foldedY{(1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f)};
+      x = foldedX;
+      y = foldedY;
+    }
+    return {toSnorm16(x), toSnorm16(y)};
+  }
+} // namespace
+
+void VertexFormat::begin(std::vector<std::byte> &data,
+                         std::size_t vertexCount, const glm::vec3 &boundsMin,
+                         const glm::vec3 &boundsMax, bool withTexCoords,
+                         bool floatTexCoords)
+{
+  m_packed = true;
+  m_hasTexCoords = withTexCoords;
+  m_floatTexCoords = withTexCoords && floatTexCoords;
+  m_stride = withTexCoords ? tangentOffset() + 4 : 12;
+  m_positionOffset = boundsMin;
+  m_positionScale = boundsMax - boundsMin;
+  data.assign(vertexCount * m_stride, std::byte{});
+}
+
+void VertexFormat::encode(std::byte *destination, const glm::vec3 &position,
+                          const glm::vec3 &normal, const glm::vec2 &texCoord,
+                          const glm::vec4 &tangent) const
+{
+  std::array<std::uint16_t, 4> packedPosition{};
+  for (const auto i : {0, 1, 2})
+  {
+    const auto extent{m_positionScale[i]};
+    packedPosition[i] = toUnorm16(
+        extent > 0.0f ? (position[i] - m_positionOffset[i]) / extent : 0.0f);
+  }
+  packedPosition[3] = (m_hasTexCoords && tangent.w < 0.0f) ? 0 : 65535;
+  std::memcpy(destination + positionOffset, packedPosition.data(),
+              sizeof(packedPosition));
+
+  const auto packedNormal{encodeOctahedral(normal)};
+  std::memcpy(destination + normalOffset, packedNormal.data(),
+              sizeof(packedNormal));
+
+  if (m_hasTexCoords)
+  {
+    if (m_floatTexCoords)
+    {
+      std::memcpy(destination + texCoordOffset, &texCoord, sizeof(texCoord));
+    }
+    else
+    {
+      const std::array<std::uint16_t, 2> packedTexCoord{
+          glm::packHalf1x16(texCoord.x), glm::packHalf1x16(texCoord.y)};
+      std::memcpy(destination + texCoordOffset, packedTexCoord.data(),
+                  sizeof(packedTexCoord));
+    }
+
+    const auto packedTangent{encodeOctahedral(glm::vec3(tangent))};
+    std::memcpy(destination + tangentOffset(), packedTangent.data(),
+                sizeof(packedTangent));
+  }
+}
+
+GLsizei VertexFormat::tangentOffset() const
+{
+  return texCoordOffset + (m_floatTexCoords ? 8 : 4);
+}
+
+void VertexFormat::setupAttributes(const Program &program) const
+{
+  const GLint positionAttribute{program.attribute("inPosition")};
+  if (positionAttribute >= 0)
+  {
+    abcg::glEnableVertexAttribArray(positionAttribute);
+    abcg::glVertexAttribPointer(positionAttribute, 4, GL_UNSIGNED_SHORT,
+                                GL_TRUE, m_stride,
+                                reinterpret_cast<void *>(positionOffset));
+  }
+
+  const GLint normalAttribute{program.attribute("inNormal")};
+  if (normalAttribute >= 0)
+  {
+    abcg::glEnableVertexAttribArray(normalAttribute);
+    abcg::glVertexAttribPointer(normalAttribute, 2, GL_SHORT, GL_TRUE,
+                                m_stride,
+                                reinterpret_cast<void *>(normalOffset));
+  }
+
+  if (!m_hasTexCoords)
+    return;
+
+  const GLint texCoordAttribute{program.attribute("inTexCoord")};
+  if (texCoordAttribute >= 0)
+  {
+    abcg::glEnableVertexAttribArray(texCoordAttribute);
+    abcg::glVertexAttribPointer(texCoordAttribute, 2,
+                                m_floatTexCoords ? GL_FLOAT : GL_HALF_FLOAT,
+                                GL_FALSE, m_stride,
+                                reinterpret_cast<void *>(texCoordOffset));
+  }
+
+  const GLint tangentCoordAttribute{program.attribute("inTangent")};
+  if (tangentCoordAttribute >= 0)
+  {
+    abcg::glEnableVertexAttribArray(tangentCoordAttribute);
+    abcg::glVertexAttribPointer(tangentCoordAttribute, 2, GL_SHORT, GL_TRUE,
+                                m_stride,
+                                reinterpret_cast<void *>(tangentOffset()));
+  }
+}
+
+void VertexFormat::setUniforms(Program &program) const
+{
+  program.set(program.uniform("positionScale"), m_positionScale);
+  program.set(program.uniform("positionOffset"), m_positionOffset);
+  program.set(program.uniform("octNormals"), m_packed ? 1 : 0);
+}
@@ -0,0 +1,69 @@
+#ifndef VERTEXFORMAT_HPP_
+#define VERTEXFORMAT_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "abcg.hpp"
+#include "program.hpp"
+
+// Layout of the vertices uploaded to a VBO. By default vertices are uploaded
+// as they are (floats); pack() switches to a compressed layout:
+//
+//   offset 0:  position, unsigned normalized 16-bit xyz over the mesh bounds,
+//              w holds the tangent handedness (0 is -1, 1 is +1)
+//   offset 8:  normal, octahedral signed normalized 16-bit pair
+//   offset 12: texture coordinates, half floats (only with texCoords), or
+//              floats with floatTexCoords for coordinates far from [0, 1]
+//   offset 16: tangent, octahedral signed normalized 16-bit pair (idem);
+//              offset 20 with float texture coordinates
+//
+// That is 20 bytes per vertex (24 with float texture coordinates), or 12
+// without texture coordinates, instead of the 48 of Vertex. The vertex
+// shaders decode it with the uniforms set by setUniforms().
+class VertexFormat
+{
+public:
+  template <typename V>
+  [[nodiscard]] std::vector<std::byte>
+  pack(const std::vector<V> &vertices, const glm::vec3 &boundsMin,
+       const glm::vec3 &boundsMax, bool withTexCoords,
+       bool floatTexCoords = false)
+  {
+    std::vector<std::byte> data;
+    begin(data, vertices.size(), boundsMin, boundsMax, withTexCoords,
+          floatTexCoords);
+    for (std::size_t i{}; i < vertices.size(); ++i)
+    {
+      const auto &vertex{vertices[i]};
+      encode(data.data() + i * m_stride, vertex.position, vertex.normal,
+             vertex.texCoord, vertex.tangent);
+    }
+    return data;
+  }
+
+  // Binds the attributes of the packed layout; the VBO must be bound
+  void setupAttributes(const Program &program) const;
+  void setUniforms(Program &program) const;
+
+  [[nodiscard]] bool isPacked() const { return m_packed; }
+  [[nodiscard]] GLsizei stride() const { return m_stride; }
+
+private:
+  bool m_packed{false};
+  bool m_hasTexCoords{false};
+  bool m_floatTexCoords{false};
+  GLsizei m_stride{};
+  glm::vec3 m_positionScale{1.0f};
+  glm::vec3 m_positionOffset{0.0f};
+
+  void begin(std::vector<std::byte> &data, std::size_t vertexCount,
+             const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+             bool withTexCoords, bool floatTexCoords);
+  [[nodiscard]] GLsizei tangentOffset() const;
+  void encode(std::byte *destination, const glm::vec3 &position,
+              const glm::vec3 &normal, const glm::vec2 &texCoord,
+              const glm::vec4 &tangent) const;
+};
+
+#endif
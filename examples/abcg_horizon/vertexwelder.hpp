@@ -0,0 +1,101 @@
+#ifndef VERTEXWELDER_HPP_
+#define VERTEXWELDER_HPP_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "abcg.hpp"
+
+// Deduplicates vertices made of N float attributes. Vertices weld only if
+// every attribute compares equal, whatever the scale of the mesh, and are
+// looked up in a flat open-addressing table sized once from the number of
+// corners.
+template <std::size_t N> class VertexWelder
+{
+public:
+  using Key = std::array<std::int32_t, N>;
+
+  explicit VertexWelder(std::size_t maxVertices)
+  {
+    // Keep the load factor below 3/4
+    std::size_t capacity{16};
+    while (capacity * 3 < maxVertices * 4)
+      capacity *= 2;
+    m_slots.assign(capacity, Slot{});
+    m_mask = capacity - 1;
+    m_keys.reserve(maxVertices);
+  }
+
+  // Bit patterns of the attributes, with -0 as +0 so that keys are equal
+  // exactly when the floats are
+  [[nodiscard]] static Key makeKey(const std::array<float, N> &attributes)
+  {
+    Key key{};
+    for (std::size_t i{}; i < N; ++i)
+    {
+      const auto value{attributes[i] == 0.0f ? 0.0f : attributes[i]};
+      std::memcpy(&key[i], &value, sizeof(value));
+    }
+    return key;
+  }
+
+  // Returns the index of the vertex welded to key and whether it is new.
+  // New vertices are numbered in insertion order.
+  std::pair<GLuint, bool> insert(const Key &key)
+  {
+    const auto hash{hashKey(key)};
+    const auto tag{static_cast<std::uint32_t>(hash >> 32)};
+    for (auto slot{hash & m_mask};; slot = (slot + 1) & m_mask)
+    {
+      auto &entry{m_slots[slot]};
+      if (entry.index == empty)
+      {
+        entry.index = static_cast<GLuint>(m_keys.size());
+        entry.tag = tag;
+        m_keys.push_back(key);
+        return {entry.index, true};
+      }
+      if (entry.tag == tag && m_keys[entry.index] == key)
+        return {entry.index, false};
+    }
+  }
+
+  [[nodiscard]] std::size_t size() const { return m_keys.size(); }
+
+private:
+  static constexpr GLuint empty{std::numeric_limits<GLuint>::max()};
+
+  struct Slot
+  {
+    GLuint index{empty};
+    std::uint32_t tag{}; // High bits of the hash, checked before the key
+  };
+
+  std::vector<Slot> m_slots;
+  std::vector<Key> m_keys;
+  std::uint64_t m_mask{};
+
+  static std::uint64_t hashKey(const Key &key)
+  {
+    std::uint64_t h{0x9e3779b97f4a7c15ull};
+    for (const auto value : key)
+    {
+      h ^= static_cast<std::uint32_t>(value);
+      h *= 0xbf58476d1ce4e5b9ull;
+      h ^= h >> 31;
+    }
+    // Final avalanche (MurmurHash3 fmix64)
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <list>
 #include "abcg.hpp"
 #include "gamedata.hpp"
+#include "program.hpp"
 
 enum Direcao {Cima, Baixo, Esquerda, Direita};
 
@@ -18,7 +19,7 @@ class Cobrinha
 {
 public: 
     // Funções usadas pela OpenGLWindow
-    void initializeGL(GLuint program);
+    void initializeGL(Program &program);
     void paintGL();
     void terminateGL();
     void update();
@@ -44,7 +45,9 @@ private:
 
     abcg::ElapsedTimer m_elapsedTimer;
 
-    GLuint m_program{};
+    Program *m_program{};
+    GLint m_translationLoc{};
+    GLint m_scaleLoc{};
     GLuint m_vboPositions{};
     GLuint m_vboColors{};
     GLuint m_vao{};
@@ -1,10 +1,13 @@
 #include "comida.hpp"
+#include "glstate.hpp"
 
 
-void Comida::initializeGL(GLuint program){
+void Comida::initializeGL(Program &program){
     terminateGL();
 
-    m_program = program;
+    m_program = &program;
+    m_translationLoc = program.uniform("translation");
+    m_scaleLoc = program.uniform("scale");
     desenharQuadrado(m_color);
 }
 
@@ -31,15 +34,14 @@ void Comida::desenharQuadrado(glm::vec3 cor)
   abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   // Get location of attributes in the program
-  const auto positionAttribute{
-      abcg::glGetAttribLocation(m_program, "inPosition")};
-  const auto colorAttribute{abcg::glGetAttribLocation(m_program, "inColor")};
+  const auto positionAttribute{m_program->attribute("inPosition")};
+  const auto colorAttribute{m_program->attribute("inColor")};
 
   // Create VAO
   abcg::glGenVertexArrays(1, &m_vao);
 
   // Bind vertex attributes to current VAO
-  abcg::glBindVertexArray(m_vao);
+  glstate::bindVertexArray(m_vao);
 
   abcg::glEnableVertexAttribArray(positionAttribute);
   abcg::glBindBuffer(GL_ARRAY_BUFFER, m_vboPositions);
@@ -54,7 +56,7 @@ void Comida::desenharQuadrado(glm::vec3 cor)
   abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   // End of binding to current VAO
-  abcg::glBindVertexArray(0);
+  glstate::bindVertexArray(0);
 }
 
 void Comida::paintGL(){
@@ -62,27 +64,22 @@ void Comida::paintGL(){
 }
 
 void Comida::bloco(glm::vec2 pos) {
-  abcg::glUseProgram(m_program);
+  m_program->use();
 
   const float fator = 0.05f;
   const float offset = -1.0f + fator;
   
   const glm::vec2 translation{offset + 2*fator*(pos.x), offset + 2*fator*(pos.y)};
-  const GLint translationLocation{
-  abcg::glGetUniformLocation(m_program, "translation")};
-  abcg::glUniform2fv(translationLocation, 1, &translation.x);
+  m_program->set(m_translationLoc, translation);
 
   // Choose a random scale factor (1% to 25%)
   //std::uniform_real_distribution<float> rd2(0.01f, 0.25f);
   const auto scale{fator};
-  const GLint scaleLocation{abcg::glGetUniformLocation(m_program, "scale")};
-  abcg::glUniform1f(scaleLocation, scale);
+  m_program->set(m_scaleLoc, scale);
 
   // Render
-  abcg::glBindVertexArray(m_vao);
+  glstate::bindVertexArray(m_vao);
   abcg::glDrawArrays(GL_TRIANGLE_FAN, 0, 5); // 4 + 2
-  abcg::glBindVertexArray(0);
-  abcg::glUseProgram(0);
 }
 
 void Comida::terminateGL(){
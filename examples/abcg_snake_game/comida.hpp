@@ -6,6 +6,7 @@
 #include <vector>
 #include "abcg.hpp"
 #include "gamedata.hpp"
+#include "program.hpp"
 
 class OpenGLWindow;
 class Cobrinha;
@@ -14,7 +15,7 @@ class Tabuleiro;
 class Comida
 {
 public: 
-    void initializeGL(GLuint program);
+    void initializeGL(Program &program);
     void paintGL();
     void terminateGL();
     void update(const GameData &gameData);
@@ -25,7 +26,9 @@ private:
     // Variaveis
     glm::vec2 m_posicao_comida{7, 7};
 
-    GLuint m_program{};
+    Program *m_program{};
+    GLint m_translationLoc{};
+    GLint m_scaleLoc{};
     GLuint m_vboPositions{};
     GLuint m_vboColors{};
     GLuint m_vao{};
@@ -2,6 +2,7 @@
 #include <imgui.h>
 #include <cppitertools/itertools.hpp>
 #include "abcg.hpp"
+#include "glstate.hpp"
 
 void OpenGLWindow::handleEvent(SDL_Event &event)
 {
@@ -39,8 +40,8 @@ void OpenGLWindow::initializeGL()
   }
 
   // Create program to render the other objects
-  m_objectsProgram = createProgramFromFile(getAssetsPath() + "objects.vert",
-                                           getAssetsPath() + "objects.frag");
+  m_objectsProgram = Program{createProgramFromFile(
+      getAssetsPath() + "objects.vert", getAssetsPath() + "objects.frag")};
 
   abcg::glClearColor(0, 0, 0, 1);
 
@@ -127,6 +128,7 @@ void OpenGLWindow::paintGL()
     if (m_gameData.comida_existe)
       m_comida.paintGL();
   }
+  glstate::bindVertexArray(0);
 }
 
 void OpenGLWindow::paintUI()
@@ -169,7 +171,7 @@ void OpenGLWindow::resizeGL(int width, int height)
 
 void OpenGLWindow::terminateGL()
 {
-  abcg::glDeleteProgram(m_objectsProgram);
+  abcg::glDeleteProgram(m_objectsProgram.id());
   m_cobrinha.terminateGL();
 }
 
@@ -21,7 +21,7 @@ protected:
     void terminateGL() override;
 
 private:
-    GLuint m_objectsProgram{};
+    Program m_objectsProgram;
 
     int m_viewportWidth{};
     int m_viewportHeight{};
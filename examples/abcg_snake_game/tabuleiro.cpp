@@ -1,8 +1,9 @@
 #include "tabuleiro.hpp"
+#include "glstate.hpp"
 #include <cppitertools/itertools.hpp>
 
 
-void Tabuleiro::initializeGL(GLuint program){
+void Tabuleiro::initializeGL(Program &program){
     terminateGL();
 
     // (0, 0) -> (18, 0)
@@ -23,7 +24,9 @@ void Tabuleiro::initializeGL(GLuint program){
     }
 
     borda_index = 0;
-    m_program = program;
+    m_program = &program;
+    m_translationLoc = program.uniform("translation");
+    m_scaleLoc = program.uniform("scale");
     desenharQuadrado(m_color);
 }
 
@@ -49,15 +52,14 @@ void Tabuleiro::desenharQuadrado(std::vector<glm::vec3> cor)
   abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   // Get location of attributes in the program
-  const auto positionAttribute{
-      abcg::glGetAttribLocation(m_program, "inPosition")};
-  const auto colorAttribute{abcg::glGetAttribLocation(m_program, "inColor")};
+  const auto positionAttribute{m_program->attribute("inPosition")};
+  const auto colorAttribute{m_program->attribute("inColor")};
 
   // Create VAO
   abcg::glGenVertexArrays(1, &m_vao);
 
   // Bind vertex attributes to current VAO
-  abcg::glBindVertexArray(m_vao);
+  glstate::bindVertexArray(m_vao);
 
   abcg::glEnableVertexAttribArray(positionAttribute);
   abcg::glBindBuffer(GL_ARRAY_BUFFER, m_vboPositions);
@@ -72,7 +74,7 @@ void Tabuleiro::desenharQuadrado(std::vector<glm::vec3> cor)
   abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   // End of binding to current VAO
-  abcg::glBindVertexArray(0);
+  glstate::bindVertexArray(0);
 }
 
 void Tabuleiro::paintGL(){
@@ -82,27 +84,22 @@ void Tabuleiro::paintGL(){
 }
 
 void Tabuleiro::bloco(glm::vec2 pos) {
-  abcg::glUseProgram(m_program);
+  m_program->use();
 
   const float fator = 0.05f;
   const float offset = -1.0f + fator;
   
   const glm::vec2 translation{offset + 2*fator*(pos.x), offset + 2*fator*(pos.y)};
-  const GLint translationLocation{
-  abcg::glGetUniformLocation(m_program, "translation")};
-  abcg::glUniform2fv(translationLocation, 1, &translation.x);
+  m_program->set(m_translationLoc, translation);
 
   // Choose a random scale factor (1% to 25%)
   //std::uniform_real_distribution<float> rd2(0.01f, 0.25f);
   const auto scale{fator};
-  const GLint scaleLocation{abcg::glGetUniformLocation(m_program, "scale")};
-  abcg::glUniform1f(scaleLocation, scale);
+  m_program->set(m_scaleLoc, scale);
 
   // Render
-  abcg::glBindVertexArray(m_vao);
+  glstate::bindVertexArray(m_vao);
   abcg::glDrawArrays(GL_TRIANGLE_FAN, 0, 5); // 4 + 1
-  abcg::glBindVertexArray(0);
-  abcg::glUseProgram(0);
 }
 
 void Tabuleiro::terminateGL(){
@@ -6,6 +6,7 @@
 #include <random>
 #include "abcg.hpp"
 #include "gamedata.hpp"
+#include "program.hpp"
 
 class OpenGLWindow;
 class Cobrinha;
@@ -14,7 +15,7 @@ class Comida;
 class Tabuleiro
 {
 public:
-    void initializeGL(GLuint program);
+    void initializeGL(Program &program);
     void paintGL();
     void terminateGL();
     void update();
@@ -27,7 +28,9 @@ private:
     std::vector<glm::vec2> borda;
     std::uint8_t borda_index{0};
 
-    GLuint m_program{};
+    Program *m_program{};
+    GLint m_translationLoc{};
+    GLint m_scaleLoc{};
     GLuint m_vboPositions{};
     GLuint m_vboColors{};
     GLuint m_vao{};
@@ -1,10 +1,10 @@
 #version 410
 
-uniform vec4 color;
+flat in vec4 fragColor;
 out vec4 outColor;
 
 void main() {
   float i = gl_FragCoord.z - 0.1f;
 
-  outColor = color-i;
+  outColor = fragColor-i;
 }
\ No newline at end of file
@@ -1,19 +1,33 @@
 #version 410 core
 
 layout(location = 0) in vec3 inPosition;
+layout(location = 1) in float inMaterial;
 
 uniform float angle;
 uniform float posY;
 uniform float posX;
 uniform float posZ;
 
+// Color and exploded view offset of each part
+struct PaletteEntry {
+  vec4 color;
+  float explodeOffset;
+};
+
+layout(std140) uniform Palette {
+  PaletteEntry palette[16];
+};
+
+flat out vec4 fragColor;
 
 void main() {
   float sinAngle = sin(angle);
   float cosAngle = cos(angle);
+  PaletteEntry entry = palette[int(inMaterial)];
+  fragColor = entry.color;
 
   gl_Position =
       vec4((inPosition.x + posX) * cosAngle + (inPosition.z + posZ) * sinAngle, 
-           inPosition.y + posY,
+           inPosition.y + posY - entry.explodeOffset,
            (inPosition.z + posZ) * cosAngle - (inPosition.x + posX) * sinAngle, 1.0);
 }
\ No newline at end of file
@@ -1,12 +1,17 @@
 #include "openglwindow.hpp"
 #include <fmt/core.h>
 #include <imgui.h>
-#include <tiny_obj_loader.h>
 #include <cppitertools/itertools.hpp>
 #include <glm/gtx/fast_trigonometry.hpp>
 #include <glm/gtx/hash.hpp>
+#include <cstddef>
+#include <cstring>
 #include <unordered_map>
 
+#include "glstate.hpp"
+#include "meshcache.hpp"
+#include "objparser.hpp"
+
 // Custom specialization of std::hash injected in namespace std
 namespace std
 {
@@ -16,7 +21,8 @@ namespace std
     size_t operator()(Vertex const &vertex) const noexcept
     {
       std::size_t h1{std::hash<glm::vec3>()(vertex.position)};
-      return h1;
+      std::size_t h2{std::hash<float>()(vertex.material)};
+      return h1 ^ (h2 << 1);
     }
   };
 } // namespace std
@@ -93,12 +99,15 @@ void OpenGLWindow::initializeGL()
   glEnable(GL_DEPTH_TEST);
 
   // Create program
-  m_program = createProgramFromFile(getAssetsPath() + "testarossa.vert",
-                                    getAssetsPath() + "testarossa.frag");
+  m_program = Program{createProgramFromFile(
+      getAssetsPath() + "testarossa.vert", getAssetsPath() + "testarossa.frag")};
+  m_posXLoc = m_program.uniform("posX");
+  m_posYLoc = m_program.uniform("posY");
+  m_posZLoc = m_program.uniform("posZ");
+  m_angleLoc = m_program.uniform("angle");
 
   // Load model
   loadModelFromFile(getAssetsPath() + "testarossa.obj");
-  standardizeBody();
   m_vertices_ToDraw = m_indices.size();
 
   // Generate VBO
@@ -119,41 +128,55 @@ void OpenGLWindow::initializeGL()
   glGenVertexArrays(1, &m_VAO);
 
   // Bind vertex attributes to current VAO
-  glBindVertexArray(m_VAO);
+  glstate::bindVertexArray(m_VAO);
 
   glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-  GLint positionAttribute{glGetAttribLocation(m_program, "inPosition")};
+  GLint positionAttribute{m_program.attribute("inPosition")};
 
   glEnableVertexAttribArray(positionAttribute);
   glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE,
                         sizeof(Vertex), nullptr);
+
+  GLint materialAttribute{m_program.attribute("inMaterial")};
+  glEnableVertexAttribArray(materialAttribute);
+  glVertexAttribPointer(materialAttribute, 1, GL_FLOAT, GL_FALSE,
+                        sizeof(Vertex),
+                        reinterpret_cast<void *>(offsetof(Vertex, material)));
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
 
   // End of binding to current VAO
-  glBindVertexArray(0);
+  glstate::bindVertexArray(0);
+
+  // Palette of part colors, filled by the first paintGL
+  glGenBuffers(1, &m_paletteUBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, m_paletteUBO);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(m_palette), nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glUniformBlockBinding(m_program.id(),
+                        glGetUniformBlockIndex(m_program.id(), "Palette"),
+                        paletteBinding);
+  glBindBufferBase(GL_UNIFORM_BUFFER, paletteBinding, m_paletteUBO);
 }
 
 void OpenGLWindow::loadModelFromFile(std::string_view path)
 {
-  tinyobj::ObjReader reader;
-
-  if (!reader.ParseFromFile(path.data())) {
-    if (!reader.Error().empty()) {
-      throw abcg::Exception{abcg::Exception::Runtime(
-        fmt::format("Failed to load model {} ({})", path, reader.Error()))};
-    }
-    throw abcg::Exception{
-      abcg::Exception::Runtime(fmt::format("Failed to load model {}", path))};
-  }
+  abcg::ElapsedTimer timer;
 
-  if (!reader.Warning().empty()) {
-    fmt::print("Warning: {}\n", reader.Warning());
+  // Try the binary cache first
+  const MeshCacheKey cacheKey{MeshCache::hashFile(path),
+                              MeshCacheKey::standardized, sizeof(Vertex)};
+  const auto cachePath{MeshCache::cachePath(path)};
+  if (MeshCache cache; cache.open(cachePath, cacheKey))
+  {
+    cache.copyTo(m_vertices, m_indices);
+    fmt::print("{}: loaded from cache in {:.2f} ms\n", path,
+               timer.elapsed() * 1000.0);
+    return;
   }
 
-  const auto &attrib{reader.GetAttrib()};
-  const auto &shapes{reader.GetShapes()};
+  const auto obj{parseObj(path)};
 
   m_vertices.clear();
   m_indices.clear();
@@ -161,46 +184,41 @@ void OpenGLWindow::loadModelFromFile(std::string_view path)
   // A key:value map with key=Vertex and value=index
   std::unordered_map<Vertex, GLuint> hash{};
 
-  // Loop over shapes
-  for (const auto &shape : shapes)
+  // Loop over the parts (objects, groups or materials) of the file
+  for (const auto part : iter::range(obj.submeshes.size()))
   {
-    // Loop over faces(polygon)
-    size_t indexOffset{0};
-    for (const auto faceNumber :
-         iter::range(shape.mesh.num_face_vertices.size()))
+    const auto &submesh{obj.submeshes[part]};
+
+    // Loop over triangle corners
+    for (const auto corner : iter::range(submesh.indexCount))
     {
-      // Number of vertices composing face f
-      std::size_t numFaceVertices{shape.mesh.num_face_vertices[faceNumber]};
-      // Loop over vertices in the face
-      std::size_t startIndex{};
-      for (const auto vertexNumber : iter::range(numFaceVertices))
+      const auto &index{obj.indices.at(submesh.firstIndex + corner)};
+
+      // Vertex coordinates
+      const int startIndex{3 * index.vertex};
+      Vertex vertex{};
+      vertex.position = {obj.positions.at(startIndex + 0),
+                         obj.positions.at(startIndex + 1),
+                         obj.positions.at(startIndex + 2)};
+      vertex.material = static_cast<float>(part % paletteSize);
+
+      // If hash doesn't contain this vertex
+      if (hash.count(vertex) == 0)
       {
-        // Access to vertex
-        tinyobj::index_t index{shape.mesh.indices[indexOffset + vertexNumber]};
-
-        // Vertex coordinates
-        startIndex = 3 * index.vertex_index;
-        tinyobj::real_t vx = attrib.vertices[startIndex + 0];
-        tinyobj::real_t vy = attrib.vertices[startIndex + 1];
-        tinyobj::real_t vz = attrib.vertices[startIndex + 2];
-
-        Vertex vertex{};
-        vertex.position = {vx, vy, vz};
-
-        // If hash doesn't contain this vertex
-        if (hash.count(vertex) == 0)
-        {
-          // Add this index (size of m_vertices)
-          hash[vertex] = m_vertices.size();
-          // Add this vertex
-          m_vertices.push_back(vertex);
-        }
-
-        m_indices.push_back(hash[vertex]);
+        // Add this index (size of m_vertices)
+        hash[vertex] = m_vertices.size();
+        // Add this vertex
+        m_vertices.push_back(vertex);
       }
-      indexOffset += numFaceVertices;
+
+      m_indices.push_back(hash[vertex]);
     }
   }
+
+  standardizeBody();
+
+  MeshCache::save(cachePath, cacheKey, m_vertices, m_indices, {});
+  fmt::print("{}: parsed in {:.2f} ms\n", path, timer.elapsed() * 1000.0);
 }
 
 void OpenGLWindow::standardizeBody()
@@ -237,51 +255,47 @@ void OpenGLWindow::paintGL()
 
   // Clear color buffer and depth buffer
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  GLint posX{glGetUniformLocation(m_program, "posX")};
-  GLint posY{glGetUniformLocation(m_program, "posY")};
-  GLint posZ{glGetUniformLocation(m_program, "posZ")};
-  GLint colorLoc{glGetUniformLocation(m_program, "color")};
   glViewport(0, 0, m_viewportWidth, m_viewportHeight);
 
-  glUseProgram(m_program);
-  glBindVertexArray(m_VAO);
+  // ImGui restores what it changes, so these stay bound between frames
+  m_program.use();
+  glstate::bindVertexArray(m_VAO);
 
-  glUniform1f(posX, x); 
-  glUniform1f(posY, y); 
-  glUniform1f(posZ, z); 
+  m_program.set(m_posXLoc, x);
+  m_program.set(m_posYLoc, y);
+  m_program.set(m_posZLoc, z);
 
   // Update uniform variable
-  GLint angleLoc{glGetUniformLocation(m_program, "angle")};
-  glUniform1f(angleLoc, m_angle);
+  m_program.set(m_angleLoc, m_angle);
 
-  // Inicia a sequência desenhando o chassis
-  if (isVisaoExplodida)
-  {
-    glUniform1f(posY, y - m_sequencia_offset_explosao[0]);
-  }
-  glUniform4f(colorLoc, chassisColor[0], chassisColor[1], chassisColor[2], chassisColor[3]);
-  m_vertices_ToDraw = m_fim_chassis;
+  // O carro inteiro em uma única chamada; a cor e o deslocamento de cada
+  // parte vêm da paleta
+  updatePalette();
   glDrawElements(GL_TRIANGLES, m_vertices_ToDraw, GL_UNSIGNED_INT, nullptr);
+}
 
-  // Continuação da sequência
-  for (long unsigned int index = 1; index < m_sequencia_objetos.size(); index++) {
+void OpenGLWindow::updatePalette()
+{
+  std::array<PaletteEntry, paletteSize> palette{};
+  for (const auto index : iter::range(paletteSize))
+  {
+    const auto colorIndex{m_sequencia_indices[index]};
+    palette[index].color = colorList[static_cast<std::size_t>(colorIndex)];
     if (isVisaoExplodida)
     {
-      glUniform1f(posY, y - m_sequencia_offset_explosao[index]);
+      palette[index].explodeOffset = m_sequencia_offset_explosao[index];
     }
-    drawBody(colorLoc, m_sequencia_objetos[index], m_sequencia_objetos[index-1], colorList[m_sequencia_indices[index]]);
   }
 
-  glBindVertexArray(0);
-  glUseProgram(0);
-}
-
-void OpenGLWindow::drawBody(GLint colorLoc, int proximo, int anterior, glm::vec4 cor)
-{
-  // Desenha um dos corpos contidos no arquivo .obj de acordo com os índices definidos nas constantes
-  glUniform4f(colorLoc, cor[0], cor[1], cor[2], cor[3]);
-  m_vertices_ToDraw = proximo - anterior;
-  glDrawElements(GL_TRIANGLES, m_vertices_ToDraw, GL_UNSIGNED_INT, (void *)(anterior * sizeof(GLuint)));
+  // Upload only when the UI changed something
+  if (std::memcmp(palette.data(), m_palette.data(), sizeof(palette)) == 0)
+  {
+    return;
+  }
+  m_palette = palette;
+  glBindBuffer(GL_UNIFORM_BUFFER, m_paletteUBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(m_palette), m_palette.data());
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void OpenGLWindow::paintUI()
@@ -455,8 +469,13 @@ void OpenGLWindow::resizeGL(int width, int height)
 
 void OpenGLWindow::terminateGL()
 {
-  glDeleteProgram(m_program);
+  glDeleteProgram(m_program.id());
+  glDeleteBuffers(1, &m_paletteUBO);
   glDeleteBuffers(1, &m_EBO);
   glDeleteBuffers(1, &m_VBO);
   glDeleteVertexArrays(1, &m_VAO);
+
+  const auto &stats{glstate::stats()};
+  fmt::print("GL state changes: {} issued, {} redundant skipped\n",
+             stats.issued, stats.skipped);
 }
\ No newline at end of file
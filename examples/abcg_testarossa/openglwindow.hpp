@@ -2,16 +2,26 @@
 #define OPENGLWINDOW_HPP_
 
 #include "abcg.hpp"
+#include "program.hpp"
+#include <array>
 #include <vector>
 
 struct Vertex {
   glm::vec3 position;
+  float material{}; // Entry of the palette, baked from the part of the vertex
 
   bool operator==(const Vertex& other) const {
-    return position == other.position;
+    return position == other.position && material == other.material;
   }
 };
 
+// One entry of the Palette uniform block (std140)
+struct PaletteEntry {
+  glm::vec4 color{};
+  float explodeOffset{};
+  float padding[3]{};
+};
+
 class OpenGLWindow : public abcg::OpenGLWindow {
  protected:
   void initializeGL() override;
@@ -19,13 +29,17 @@ class OpenGLWindow : public abcg::OpenGLWindow {
   void paintUI() override;
   void resizeGL(int width, int height) override;
   void terminateGL() override;
-  void drawBody(GLint colorLoc, int proximo, int anterior, glm::vec4 cor);
 
  private:
   GLuint m_VAO{};
   GLuint m_VBO{};
   GLuint m_EBO{};
-  GLuint m_program{};
+  Program m_program;
+  GLint m_posXLoc{};
+  GLint m_posYLoc{};
+  GLint m_posZLoc{};
+  GLint m_angleLoc{};
+  GLuint m_paletteUBO{};
 
   int m_viewportWidth{};
   int m_viewportHeight{};
@@ -64,17 +78,12 @@ class OpenGLWindow : public abcg::OpenGLWindow {
   void loadModelFromFile(std::string_view path);
   void standardizeBody();
 
-  // Valores obtidos usando o script testarossa.py
-  const int m_fim_chassis = 63705;
-  const int m_fim_limpadores = 67569;
-  const int m_fim_black = 67809;
-  const int m_fim_lanterna_di = 70041;
-  const int m_fim_interior = 159519;
-  const int m_fim_grelhas = 175824;
-  const int m_fim_vidros = 178392;
-  const int m_fim_lanterna_tr = 178758;
-  const int m_fim_pneu[4] = {190104, 219672, 249240, 278808};
-  const int m_fim_roda[4] = {208326, 237894, 267462, 297030};
+  // Colors and offsets of the parts. Recoloring rewrites these 16 entries
+  // instead of issuing a draw per part; parts past the 16th share them.
+  static constexpr std::size_t paletteSize{16};
+  static constexpr GLuint paletteBinding{0};
+  std::array<PaletteEntry, paletteSize> m_palette{};
+  void updatePalette();
 
   const float m_offset_chassis = -0.1;
   const float m_offset_limpadores = -0.6;
@@ -87,12 +96,6 @@ class OpenGLWindow : public abcg::OpenGLWindow {
   const float m_offset_pneu[4] = {0.3, 0.3, 0.3, 0.3};
   const float m_offset_roda[4] = {0.6, 0.6, 0.6, 0.6};
 
-  const std::vector<int> m_sequencia_objetos = {
-    m_fim_chassis, m_fim_limpadores, m_fim_black, m_fim_lanterna_di, m_fim_interior, 
-    m_fim_grelhas, m_fim_vidros, m_fim_lanterna_tr, m_fim_pneu[0], m_fim_roda[0], 
-    m_fim_pneu[1], m_fim_roda[1], m_fim_pneu[2], m_fim_roda[2], m_fim_pneu[3], m_fim_roda[3]
-  };
-
   const std::vector<float> m_sequencia_offset_explosao = {
     m_offset_chassis, m_offset_limpadores, m_offset_black, m_offset_lanterna_di, m_offset_interior, 
     m_offset_grelhas, m_offset_vidros, m_offset_lanterna_tr, m_offset_pneu[0], m_offset_roda[0], 
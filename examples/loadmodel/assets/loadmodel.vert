@@ -4,11 +4,16 @@ layout(location = 0) in vec3 inPosition;
 
 uniform float angle;
 
+// Maps the model bounds to [-1, 1]
+uniform vec3 center;
+uniform float scale;
+
 void main() {
   float sinAngle = sin(angle);
   float cosAngle = cos(angle);
+  vec3 position = (inPosition - center) * scale;
 
-  gl_Position = vec4( inPosition.x * cosAngle + inPosition.z * sinAngle,
-                      inPosition.y,
-                      inPosition.z * cosAngle - inPosition.x * sinAngle, 1.0);
+  gl_Position = vec4( position.x * cosAngle + position.z * sinAngle,
+                      position.y,
+                      position.z * cosAngle - position.x * sinAngle, 1.0);
 }
\ No newline at end of file
@@ -2,26 +2,94 @@
 
 #include <fmt/core.h>
 #include <imgui.h>
-#include <tiny_obj_loader.h>
 
 #include <cppitertools/itertools.hpp>
 #include <glm/gtx/fast_trigonometry.hpp>
-#include <glm/gtx/hash.hpp>
-#include <unordered_map>
 
-// Explicit specialization of std::hash for Vertex
-namespace std
+#include "glstate.hpp"
+#include "meshcache.hpp"
+#include "objparser.hpp"
+#include "vertexwelder.hpp"
+
+namespace
 {
-    template <>
-    struct hash<Vertex>
+    // Welds corners that share the same position
+    void weldPositions(const ObjData &obj, std::vector<Vertex> &vertices,
+                       std::vector<GLuint> &indices)
+    {
+        VertexWelder<3> welder{obj.indices.size()};
+        indices.reserve(obj.indices.size());
+
+        // Loop over triangle corners
+        for (const auto &index : obj.indices)
+        {
+            // Vertex position
+            const int startIndex{3 * index.vertex};
+            const float vx{obj.positions.at(startIndex + 0)};
+            const float vy{obj.positions.at(startIndex + 1)};
+            const float vz{obj.positions.at(startIndex + 2)};
+
+            Vertex vertex{};
+            vertex.position = {vx, vy, vz};
+
+            const auto [vertexIndex, isNew]{
+                    welder.insert(VertexWelder<3>::makeKey({vx, vy, vz}))};
+            if (isNew)
+            {
+                // Add this vertex
+                vertices.push_back(vertex);
+            }
+
+            indices.push_back(vertexIndex);
+        }
+    }
+
+    void standardize(std::vector<Vertex> &vertices)
     {
-        size_t operator()(Vertex const &vertex) const noexcept
+        // Center to origin and normalize largest bound to [-1, 1]
+
+        // Get bounds
+        glm::vec3 max(std::numeric_limits<float>::lowest());
+        glm::vec3 min(std::numeric_limits<float>::max());
+        for (const auto &vertex : vertices)
         {
-            const std::size_t h1{std::hash<glm::vec3>()(vertex.position)};
-            return h1;
+            max.x = std::max(max.x, vertex.position.x);
+            max.y = std::max(max.y, vertex.position.y);
+            max.z = std::max(max.z, vertex.position.z);
+            min.x = std::min(min.x, vertex.position.x);
+            min.y = std::min(min.y, vertex.position.y);
+            min.z = std::min(min.z, vertex.position.z);
         }
-    };
-} // namespace std
+
+        // Center and scale
+        const auto center{(min + max) / 2.0f};
+        const auto scaling{2.0f / glm::length(max - min)};
+        for (auto &vertex : vertices)
+        {
+            vertex.position = (vertex.position - center) * scaling;
+        }
+    }
+
+    // Uploads elements [first, count) of data, reallocating the buffer at
+    // twice the size (and uploading everything again) when they do not fit
+    void appendToBuffer(GLenum target, GLuint buffer, std::size_t &capacity,
+                        const void *data, std::size_t elementSize,
+                        std::size_t first, std::size_t count)
+    {
+        abcg::glBindBuffer(target, buffer);
+        if (count > capacity)
+        {
+            capacity = std::max(count, capacity * 2);
+            abcg::glBufferData(target, capacity * elementSize, nullptr,
+                               GL_STATIC_DRAW);
+            first = 0;
+        }
+        abcg::glBufferSubData(
+                target, first * elementSize, (count - first) * elementSize,
+                static_cast<const std::byte *>(data) + first * elementSize);
+        abcg::glBindBuffer(target, 0);
+    }
+} // namespace
 
 void OpenGLWindow::initializeGL()
 {
@@ -31,38 +99,24 @@ void OpenGLWindow::initializeGL()
     abcg::glEnable(GL_DEPTH_TEST);
 
     // Create program
-    m_program = createProgramFromFile(getAssetsPath() + "loadmodel.vert",
-                                      getAssetsPath() + "loadmodel.frag");
-
-    // Load model
-    loadModelFromFile(getAssetsPath() + "bunny.obj");
-    standardize();
+    m_program = Program{createProgramFromFile(
+        getAssetsPath() + "loadmodel.vert", getAssetsPath() + "loadmodel.frag")};
+    m_angleLoc = m_program.uniform("angle");
+    m_centerLoc = m_program.uniform("center");
+    m_scaleLoc = m_program.uniform("scale");
 
-    m_verticesToDraw = m_indices.size();
-
-    // Generate VBO
+    // Empty buffers, filled as the model arrives
     abcg::glGenBuffers(1, &m_VBO);
-    abcg::glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-    abcg::glBufferData(GL_ARRAY_BUFFER, sizeof(m_vertices[0]) * m_vertices.size(),
-                       m_vertices.data(), GL_STATIC_DRAW);
-    abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // Generate EBO
     abcg::glGenBuffers(1, &m_EBO);
-    abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-    abcg::glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                       sizeof(m_indices[0]) * m_indices.size(), m_indices.data(),
-                       GL_STATIC_DRAW);
-    abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     // Create VAO
     abcg::glGenVertexArrays(1, &m_VAO);
 
     // Bind vertex attributes to current VAO
-    abcg::glBindVertexArray(m_VAO);
+    glstate::bindVertexArray(m_VAO);
 
     abcg::glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-    GLint positionAttribute{abcg::glGetAttribLocation(m_program, "inPosition")};
+    GLint positionAttribute{m_program.attribute("inPosition")};
     abcg::glEnableVertexAttribArray(positionAttribute);
     abcg::glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE,
                                 sizeof(Vertex), nullptr);
@@ -71,98 +125,160 @@ void OpenGLWindow::initializeGL()
     abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
 
     // End of binding to current VAO
-    abcg::glBindVertexArray(0);
+    glstate::bindVertexArray(0);
+
+    // Load model
+    m_loader.load([this, path = getAssetsPath() + "bunny.obj"]
+                  { loadModelFromFile(path); },
+                  [] {});
 }
 
-void OpenGLWindow::loadModelFromFile(std::string_view path)
+// Runs on the loader thread; everything it produces reaches the GL thread
+// through queued tasks
+void OpenGLWindow::loadModelFromFile(const std::string &path)
 {
-    tinyobj::ObjReader reader;
+    abcg::ElapsedTimer timer;
 
-    if (!reader.ParseFromFile(path.data()))
+    // Try the binary cache first
+    const MeshCacheKey cacheKey{MeshCache::hashFile(path),
+                                MeshCacheKey::standardized, sizeof(Vertex)};
+    const auto cachePath{MeshCache::cachePath(path)};
+    if (MeshCache cache; cache.open(cachePath, cacheKey))
     {
-        if (!reader.Error().empty())
-        {
-            throw abcg::Exception{abcg::Exception::Runtime(
-                fmt::format("Failed to load model {} ({})", path, reader.Error()))};
-        }
-        throw abcg::Exception{
-            abcg::Exception::Runtime(fmt::format("Failed to load model {}", path))};
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> indices;
+        cache.copyTo(vertices, indices);
+        fmt::print("{}: loaded from cache in {:.2f} ms\n", path,
+                   timer.elapsed() * 1000.0);
+
+        prepareModel(std::move(vertices), std::move(indices));
+        return;
     }
 
-    if (!reader.Warning().empty())
+    // Stream the blocks to the GL thread as they are parsed
+    ObjStreamReader reader{path};
+    ObjData obj;
+    std::size_t sentVertices{};
+    std::size_t sentCorners{};
+    while (reader.read(obj))
     {
-        fmt::print("Warning: {}\n", reader.Warning());
-    }
+        std::vector<Vertex> vertices;
+        for (auto i{sentVertices}; i < obj.positions.size() / 3; ++i)
+        {
+            vertices.push_back({{obj.positions[3 * i + 0],
+                                 obj.positions[3 * i + 1],
+                                 obj.positions[3 * i + 2]}});
+        }
+        std::vector<GLuint> indices;
+        for (auto i{sentCorners}; i < obj.indices.size(); ++i)
+            indices.push_back(static_cast<GLuint>(obj.indices[i].vertex));
+
+        if (sentVertices == 0 && !vertices.empty())
+        {
+            fmt::print("{}: first block parsed in {:.2f} ms\n", path,
+                       timer.elapsed() * 1000.0);
+        }
+        sentVertices = obj.positions.size() / 3;
+        sentCorners = obj.indices.size();
 
-    const auto &attrib{reader.GetAttrib()};
-    const auto &shapes{reader.GetShapes()};
+        m_loader.enqueue(
+                [this, vertices = std::move(vertices),
+                 indices = std::move(indices)]
+                { appendBlock(vertices, indices); });
+    }
+    const auto parseTime{timer.elapsed()};
+
+    // Cache the welded, standardized mesh for the next run
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    weldPositions(obj, vertices, indices);
+    standardize(vertices);
+    MeshCache::save(cachePath, cacheKey, vertices, indices, {});
+    fmt::print("{}: streamed in {:.2f} ms, cached in {:.2f} ms\n", path,
+               parseTime * 1000.0, (timer.elapsed() - parseTime) * 1000.0);
+
+    // Replace the streamed mesh, as a cache hit would have loaded it
+    prepareModel(std::move(vertices), std::move(indices));
+}
 
-    m_vertices.clear();
-    m_indices.clear();
+// Runs on the loader thread: only the buffer uploads are left to the GL
+// thread
+void OpenGLWindow::prepareModel(std::vector<Vertex> vertices,
+                                std::vector<GLuint> indices)
+{
+    // Narrow the indices, splitting large meshes into meshlets
+    IndexLayout layout;
+    layout.build(vertices, indices, {{0, indices.size()}});
+    auto laidOut{layout.layoutVertices(vertices)};
+
+    m_loader.enqueue(
+            [this, layout = std::move(layout), vertices = std::move(laidOut),
+             indices = std::move(indices)]() mutable
+            {
+                // Keep drawing everything unless the slider was moved back
+                const auto following{m_verticesToDraw ==
+                                     static_cast<int>(m_indices.size())};
+
+                m_indexLayout = std::move(layout);
+                m_vertices = {};
+                m_indices = std::move(indices);
+                if (following)
+                    m_verticesToDraw = static_cast<int>(m_indices.size());
+                uploadModel(vertices);
+            });
+}
 
-    // A key:value map with key=Vertex and value=index
-    std::unordered_map<Vertex, GLuint> hash{};
+void OpenGLWindow::appendBlock(const std::vector<Vertex> &vertices,
+                               const std::vector<GLuint> &indices)
+{
+    m_streaming = true;
+    const auto following{m_verticesToDraw ==
+                         static_cast<int>(m_indices.size())};
 
-    // Loop over shapes
-    for (const auto &shape : shapes)
+    for (const auto &vertex : vertices)
     {
-        // Loop over indices
-        for (const auto offset : iter::range(shape.mesh.indices.size()))
-        {
-            // Access to vertex
-            const tinyobj::index_t index{shape.mesh.indices.at(offset)};
-
-            // Vertex position
-            const int startIndex{3 * index.vertex_index};
-            const float vx{attrib.vertices.at(startIndex + 0)};
-            const float vy{attrib.vertices.at(startIndex + 1)};
-            const float vz{attrib.vertices.at(startIndex + 2)};
+        m_boundsMin = glm::min(m_boundsMin, vertex.position);
+        m_boundsMax = glm::max(m_boundsMax, vertex.position);
+    }
 
-            Vertex vertex{};
-            vertex.position = {vx, vy, vz};
+    const auto firstVertex{m_vertices.size()};
+    const auto firstIndex{m_indices.size()};
+    m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+    m_indices.insert(m_indices.end(), indices.begin(), indices.end());
 
-            // If hash doesn't contain this vertex
-            if (hash.count(vertex) == 0)
-            {
-                // Add this index (size of m_vertices)
-                hash[vertex] = m_vertices.size();
-                // Add this vertex
-                m_vertices.push_back(vertex);
-            }
+    appendToBuffer(GL_ARRAY_BUFFER, m_VBO, m_vertexCapacity, m_vertices.data(),
+                   sizeof(Vertex), firstVertex, m_vertices.size());
+    appendToBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO, m_indexCapacity,
+                   m_indices.data(), sizeof(GLuint), firstIndex,
+                   m_indices.size());
 
-            m_indices.push_back(hash[vertex]);
-        }
-    }
+    // Keep drawing everything unless the slider was moved back
+    if (following)
+        m_verticesToDraw = static_cast<int>(m_indices.size());
 }
 
-void OpenGLWindow::standardize()
+void OpenGLWindow::uploadModel(const std::vector<Vertex> &vertices)
 {
-    // Center to origin and normalize largest bound to [-1, 1]
+    m_streaming = false;
 
-    // Get bounds
-    glm::vec3 max(std::numeric_limits<float>::lowest());
-    glm::vec3 min(std::numeric_limits<float>::max());
-    for (const auto &vertex : m_vertices)
-    {
-        max.x = std::max(max.x, vertex.position.x);
-        max.y = std::max(max.y, vertex.position.y);
-        max.z = std::max(max.z, vertex.position.z);
-        min.x = std::min(min.x, vertex.position.x);
-        min.y = std::min(min.y, vertex.position.y);
-        min.z = std::min(min.z, vertex.position.z);
-    }
+    // Fill VBO
+    abcg::glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    abcg::glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(),
+                       vertices.data(), GL_STATIC_DRAW);
+    abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    // Center and scale
-    const auto center{(min + max) / 2.0f};
-    const auto scaling{2.0f / glm::length(max - min)};
-    for (auto &vertex : m_vertices)
-    {
-        vertex.position = (vertex.position - center) * scaling;
-    }
+    // Fill EBO
+    const auto &indexData{m_indexLayout.data()};
+    abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    abcg::glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(),
+                       indexData.data(), GL_STATIC_DRAW);
+    abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void OpenGLWindow::paintGL()
 {
+    m_loader.drain(loadBudget);
+
     // Animate angle by 15 degrees per second
     const float deltaTime{static_cast<float>(getDeltaTime())};
     m_angle = glm::wrapAngle(m_angle + glm::radians(15.0f) * deltaTime);
@@ -172,19 +288,36 @@ void OpenGLWindow::paintGL()
 
     abcg::glViewport(0, 0, m_viewportWidth, m_viewportHeight);
 
-    abcg::glUseProgram(m_program);
-    abcg::glBindVertexArray(m_VAO);
+    m_program.use();
+    glstate::bindVertexArray(m_VAO);
 
-    // Update uniform variable
-    const GLint angleLoc{abcg::glGetUniformLocation(m_program, "angle")};
-    abcg::glUniform1f(angleLoc, m_angle);
+    // Update uniform variables
+    m_program.set(m_angleLoc, m_angle);
+
+    // Streamed positions are standardized here; cached ones already are
+    glm::vec3 center{0.0f};
+    float scale{1.0f};
+    if (m_streaming)
+    {
+        center = (m_boundsMin + m_boundsMax) / 2.0f;
+        scale = 2.0f / glm::length(m_boundsMax - m_boundsMin);
+    }
+    m_program.set(m_centerLoc, center);
+    m_program.set(m_scaleLoc, scale);
 
     // Draw triangles
-    abcg::glDrawElements(GL_TRIANGLES, m_verticesToDraw, GL_UNSIGNED_INT,
-                         nullptr);
+    if (m_streaming)
+    {
+        abcg::glDrawElements(GL_TRIANGLES, m_verticesToDraw, GL_UNSIGNED_INT,
+                             nullptr);
+    }
+    else if (!m_indices.empty())
+    {
+        m_indexLayout.draw(0, m_verticesToDraw / 3);
+    }
 
-    abcg::glBindVertexArray(0);
-    abcg::glUseProgram(0);
+    // Buffer uploads must not change the element buffer of the VAO
+    glstate::bindVertexArray(0);
 }
 
 void OpenGLWindow::paintUI()
@@ -202,7 +335,7 @@ void OpenGLWindow::paintUI()
             // Slider will fill the space of the window
             ImGui::PushItemWidth(m_viewportWidth - 25);
 
-            static int n{m_verticesToDraw / 3};
+            int n{m_verticesToDraw / 3};
             ImGui::SliderInt("", &n, 0, m_indices.size() / 3, "%d triangles");
             m_verticesToDraw = n * 3;
 
@@ -222,14 +355,7 @@ void OpenGLWindow::paintUI()
         static bool faceCulling{};
         ImGui::Checkbox("Back-face culling", &faceCulling);
 
-        if (faceCulling)
-        {
-            abcg::glEnable(GL_CULL_FACE);
-        }
-        else
-        {
-            abcg::glDisable(GL_CULL_FACE);
-        }
+        glstate::setEnabled(GL_CULL_FACE, faceCulling);
 
         // CW/CCW combo box
         {
@@ -252,14 +378,7 @@ void OpenGLWindow::paintUI()
             }
             ImGui::PopItemWidth();
 
-            if (currentIndex == 0)
-            {
-                abcg::glFrontFace(GL_CW);
-            }
-            else
-            {
-                abcg::glFrontFace(GL_CCW);
-            }
+            glstate::frontFace(currentIndex == 0 ? GL_CW : GL_CCW);
         }
 
         ImGui::End();
@@ -274,8 +393,13 @@ void OpenGLWindow::resizeGL(int width, int height)
 
 void OpenGLWindow::terminateGL()
 {
-    abcg::glDeleteProgram(m_program);
+    m_loader.shutdown();
+    abcg::glDeleteProgram(m_program.id());
     abcg::glDeleteBuffers(1, &m_EBO);
     abcg::glDeleteBuffers(1, &m_VBO);
     abcg::glDeleteVertexArrays(1, &m_VAO);
+
+    const auto &stats{glstate::stats()};
+    fmt::print("GL state changes: {} issued, {} redundant skipped\n",
+               stats.issued, stats.skipped);
 }
\ No newline at end of file
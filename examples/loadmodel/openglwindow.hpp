@@ -1,9 +1,14 @@
 #ifndef OPENGLWINDOW_HPP_
 #define OPENGLWINDOW_HPP_
 
+#include <limits>
+#include <string>
 #include <vector>
 
 #include "abcg.hpp"
+#include "assetloader.hpp"
+#include "meshlets.hpp"
+#include "program.hpp"
 
 struct Vertex
 {
@@ -28,7 +33,10 @@ private:
     GLuint m_VAO{};
     GLuint m_VBO{};
     GLuint m_EBO{};
-    GLuint m_program{};
+    Program m_program;
+    GLint m_angleLoc{};
+    GLint m_centerLoc{};
+    GLint m_scaleLoc{};
 
     int m_viewportWidth{};
     int m_viewportHeight{};
@@ -38,9 +46,26 @@ private:
 
     std::vector<Vertex> m_vertices;
     std::vector<GLuint> m_indices;
+    IndexLayout m_indexLayout;
 
-    void loadModelFromFile(std::string_view path);
-    void standardize();
+    // The model is read on a worker thread. Without a valid cache it is
+    // streamed: each parsed block is appended to buffers that grow as it
+    // arrives, and drawn with raw positions and 32-bit indices, standardized
+    // in the vertex shader from the bounds seen so far.
+    static constexpr double loadBudget{0.008}; // Seconds of uploads per frame
+    AssetLoader m_loader;
+    bool m_streaming{false};
+    std::size_t m_vertexCapacity{};
+    std::size_t m_indexCapacity{};
+    glm::vec3 m_boundsMin{std::numeric_limits<float>::max()};
+    glm::vec3 m_boundsMax{std::numeric_limits<float>::lowest()};
+
+    void loadModelFromFile(const std::string &path);
+    void appendBlock(const std::vector<Vertex> &vertices,
+                     const std::vector<GLuint> &indices);
+    void prepareModel(std::vector<Vertex> vertices,
+                      std::vector<GLuint> indices);
+    void uploadModel(const std::vector<Vertex> &vertices);
 };
 
 #endif
\ No newline at end of file